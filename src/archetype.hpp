@@ -0,0 +1,200 @@
+//An archetype stores entities that all share the exact same component set.
+//Instead of one pool per component type, entities are packed into fixed
+//size chunks and each chunk holds one column (a plain array) per component
+//type, so walking an archetype is a linear pass over a handful of arrays.
+
+//To create an archetype for a component set:
+//using image_archetype = archetype<component_pack<[component1],[...]>>;
+
+//Entities are added with every one of their components at once and can
+//be looked up, removed (swap-and-pop with the last entity) or iterated:
+//images.insert(id, [component1](id, ...), [...]);
+//images.each([](component_id id, [component1]& first, [...]){...});
+
+//Each chunk is also a self contained unit of work: chunk_count() and
+//get_chunk(index) expose the raw columns so that chunks can be handed to
+//different threads without any of them touching the same memory.
+#ifndef ARCHETYPE_HPP
+#define ARCHETYPE_HPP
+
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "game_components.hpp"
+#include "sparse_set.hpp"
+
+//Uninitialized storage for Capacity components, constructed in place
+template <class Component, std::size_t Capacity>
+struct archetype_column{
+    private:
+        std::aligned_storage_t<sizeof(Component) * Capacity, alignof(Component)> storage;
+
+    public:
+        Component* data(){return reinterpret_cast<Component*>(&storage);}
+        const Component* data() const{return reinterpret_cast<const Component*>(&storage);}
+};
+
+template <class ComponentPack, std::size_t ChunkCapacity = 128>
+class archetype;
+
+template <template <typename... Args> class t, typename... Components, std::size_t ChunkCapacity>
+class archetype<t<Components...>, ChunkCapacity>{
+    public:
+        static_assert(sizeof...(Components) > 0, "An archetype needs at least one component");
+        static_assert(ChunkCapacity > 0, "Chunks must be able to hold at least one entity");
+
+        static constexpr std::size_t chunk_capacity = ChunkCapacity;
+
+        class chunk{
+            private:
+                std::array<component_id, ChunkCapacity> entity_ids;
+                std::tuple<archetype_column<Components, ChunkCapacity>...> columns;
+                std::size_t count;
+
+                friend class archetype;
+
+                template <class Component>
+                Component* column_data(){
+                    return std::get<archetype_column<Component, ChunkCapacity>>(columns).data();
+                }
+
+                void push_back(const component_id& id, Components&&... components){
+                    entity_ids[count] = id;
+                    (void)std::initializer_list<int>{
+                        (new (column_data<Components>() + count) Components(std::move(components)), 0)...};
+                    ++count;
+                }
+
+                void move_row(std::size_t target, chunk& source, std::size_t row){
+                    entity_ids[target] = source.entity_ids[row];
+                    (void)std::initializer_list<int>{
+                        (column_data<Components>()[target] =
+                            std::move(source.template column_data<Components>()[row]), 0)...};
+                }
+
+                void pop_back(){
+                    --count;
+                    (void)std::initializer_list<int>{
+                        ((column_data<Components>() + count)->~Components(), 0)...};
+                }
+
+            public:
+                chunk() : entity_ids(), columns(), count(0) {}
+                chunk(const chunk&) = delete;
+                chunk& operator=(const chunk&) = delete;
+                ~chunk(){
+                    while(count > 0) pop_back();
+                }
+
+                std::size_t size() const{return count;}
+                bool full() const{return count == ChunkCapacity;}
+                const component_id* ids() const{return entity_ids.data();}
+
+                //Raw column of a component type, valid for [0, size())
+                template <class Component>
+                Component* column(){return column_data<Component>();}
+
+                template <class Function>
+                void each(Function function){
+                    auto data = std::make_tuple(column_data<Components>()...);
+                    for(std::size_t row = 0; row < count; ++row){
+                        function(entity_ids[row], std::get<Components*>(data)[row]...);
+                    }
+                }
+        };
+
+    private:
+        std::vector<std::unique_ptr<chunk>> chunks;
+        //Each entity maps to its row counted from the start of the first chunk
+        sparse_index<component_id> rows;
+        std::size_t count;
+
+        static constexpr std::size_t npos = sparse_index<component_id>::npos;
+
+        chunk& chunk_of(std::size_t row){return *chunks[row / ChunkCapacity];}
+
+    public:
+        archetype() : chunks(), rows(), count(0) {}
+
+        std::size_t size() const{return count;}
+        bool empty() const{return count == 0;}
+        std::size_t chunk_count() const{return chunks.size();}
+        chunk& get_chunk(std::size_t index){return *chunks[index];}
+
+        bool contains(const component_id& id) const{return rows.find(id) != npos;}
+
+        void reserve(std::size_t entity_count){
+            rows.reserve(entity_count);
+            chunks.reserve((entity_count + ChunkCapacity - 1) / ChunkCapacity);
+        }
+
+        //Returns false and leaves the archetype untouched if id is already stored
+        bool insert(const component_id& id, Components... components){
+            if(contains(id)) return false;
+
+            if(chunks.empty() || chunks.back()->full()){
+                chunks.push_back(std::make_unique<chunk>());
+            }
+            chunks.back()->push_back(id, std::move(components)...);
+            rows.set(id, count);
+            ++count;
+            return true;
+        }
+
+        //Moves the last entity into the freed row so chunks stay packed
+        bool erase(const component_id& id){
+            auto row = rows.find(id);
+            if(row == npos) return false;
+
+            auto last = count - 1;
+            auto& last_chunk = chunk_of(last);
+            if(row != last){
+                auto& target_chunk = chunk_of(row);
+                target_chunk.move_row(row % ChunkCapacity, last_chunk, last % ChunkCapacity);
+                rows.set(target_chunk.entity_ids[row % ChunkCapacity], row);
+            }
+            last_chunk.pop_back();
+            rows.erase(id);
+            --count;
+
+            if(last_chunk.size() == 0) chunks.pop_back();
+            return true;
+        }
+
+        //Returns nullptr when id isn't stored in this archetype
+        template <class Component>
+        Component* get(const component_id& id){
+            auto row = rows.find(id);
+            if(row == npos) return nullptr;
+            return chunk_of(row).template column<Component>() + (row % ChunkCapacity);
+        }
+
+        //Calls function(id, components...) for every entity, chunk by chunk
+        template <class Function>
+        void each(Function function){
+            for(auto& current : chunks){
+                current->each(function);
+            }
+        }
+
+        void clear(){
+            chunks.clear();
+            rows.clear();
+            count = 0;
+        }
+};
+
+template <template <typename... Args> class t, typename... Components, std::size_t ChunkCapacity>
+constexpr std::size_t archetype<t<Components...>, ChunkCapacity>::chunk_capacity;
+
+template <template <typename... Args> class t, typename... Components, std::size_t ChunkCapacity>
+constexpr std::size_t archetype<t<Components...>, ChunkCapacity>::npos;
+
+#endif
@@ -0,0 +1,149 @@
+//Packed asset archive, images already decoded into one pixel format so
+//loading them is a matter of pointing a surface at the pixels. Archives are
+//written offline by asset_packer (make packer) and mapped read only:
+//mapped_archive archive("Assets/assets.pak");
+//if(auto entry = archive.find("Assets/loaded.png")){
+//    auto surface = archive.surface(*entry);
+//}
+
+//Layout, every offset is from the start of the file:
+//  archive_header, version 2 added flags
+//  archive_entry[entry_count]
+//  names, not terminated, entry.name_offset/name_length
+//  pixels, entry_count blocks of height * pitch bytes, archive_alignment aligned
+//Everything is stored in the byte order of the machine that packed it.
+#ifndef ASSET_ARCHIVE_HPP
+#define ASSET_ARCHIVE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <SDL2/SDL.h>
+
+#include "sdl2_context.hpp"
+
+constexpr char archive_magic[4] = {'S', 'P', 'A', 'K'};
+constexpr std::uint32_t archive_version = 2;
+constexpr std::uint64_t archive_alignment = 16;
+//archive_header::flags
+constexpr std::uint32_t archive_premultiplied = 1;
+
+struct archive_header{
+    char magic[4];
+    std::uint32_t version;
+    //SDL_PixelFormatEnum of every image
+    std::uint32_t pixel_format;
+    std::uint32_t entry_count;
+    std::uint32_t flags;
+    std::uint32_t reserved;
+};
+
+struct archive_entry{
+    std::uint64_t name_offset;
+    std::uint64_t pixel_offset;
+    std::uint32_t name_length;
+    std::int32_t width;
+    std::int32_t height;
+    std::int32_t pitch;
+};
+
+static_assert(std::is_trivially_copyable<archive_header>::value && sizeof(archive_header) == 24,
+        "archive_header is written as is");
+static_assert(std::is_trivially_copyable<archive_entry>::value && sizeof(archive_entry) == 32,
+        "archive_entry is written as is");
+
+//Read only view of an archive file. Surfaces made from it point straight
+//into the mapping, they must not outlive the archive.
+class mapped_archive{
+    private:
+        const unsigned char* data;
+        std::size_t length;
+        const archive_header* header;
+        const archive_entry* entries;
+        std::unordered_map<std::string, std::size_t> index;
+
+        void fail(const std::string& path, const char* reason){
+            if(data) munmap(const_cast<unsigned char*>(data), length);
+            throw std::runtime_error("Error while mapping asset archive " + path + ": " + reason);
+        }
+
+    public:
+        explicit mapped_archive(const std::string& path) :
+            data(nullptr), length(0), header(nullptr), entries(nullptr), index()
+        {
+            int file = open(path.c_str(), O_RDONLY);
+            if(file < 0) fail(path, "cannot open file");
+            struct stat info;
+            if(fstat(file, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(archive_header))){
+                close(file);
+                fail(path, "file too small");
+            }
+            length = static_cast<std::size_t>(info.st_size);
+            void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file, 0);
+            close(file);
+            if(mapping == MAP_FAILED) fail(path, "mmap failed");
+            data = static_cast<const unsigned char*>(mapping);
+
+            header = reinterpret_cast<const archive_header*>(data);
+            if(std::memcmp(header->magic, archive_magic, sizeof(archive_magic)) != 0) fail(path, "not an asset archive");
+            if(header->version != archive_version) fail(path, "unsupported version");
+            std::int64_t bytes_per_pixel = SDL_BYTESPERPIXEL(header->pixel_format);
+            if(bytes_per_pixel == 0) fail(path, "unsupported pixel format");
+            //Sizes are checked against what is left after an offset, adding
+            //them to the offset could wrap around
+            if(header->entry_count > (length - sizeof(archive_header)) / sizeof(archive_entry)) fail(path, "truncated index");
+            entries = reinterpret_cast<const archive_entry*>(data + sizeof(archive_header));
+
+            index.reserve(header->entry_count);
+            for(std::size_t i = 0; i < header->entry_count; ++i){
+                auto& entry = entries[i];
+                if(entry.width <= 0 || entry.height <= 0 || entry.pitch < entry.width * bytes_per_pixel){
+                    fail(path, "invalid entry size");
+                }
+                auto pixel_bytes = static_cast<std::uint64_t>(entry.height) * static_cast<std::uint64_t>(entry.pitch);
+                if(entry.name_offset > length || entry.name_length > length - entry.name_offset ||
+                        entry.pixel_offset > length || pixel_bytes > length - entry.pixel_offset){
+                    fail(path, "entry out of bounds");
+                }
+                index.emplace(std::string(reinterpret_cast<const char*>(data + entry.name_offset), entry.name_length), i);
+            }
+        }
+
+        mapped_archive(const mapped_archive&) = delete;
+        mapped_archive& operator=(const mapped_archive&) = delete;
+
+        ~mapped_archive(){
+            munmap(const_cast<unsigned char*>(data), length);
+        }
+
+        Uint32 get_pixel_format() const{return header->pixel_format;}
+        //Color already multiplied by alpha, see sdl2::prepare_surface
+        bool is_premultiplied() const{return (header->flags & archive_premultiplied) != 0;}
+        std::size_t size() const{return header->entry_count;}
+
+        //Null if name wasn't packed
+        const archive_entry* find(const std::string& name) const{
+            auto found = index.find(name);
+            return (found == std::end(index)) ? nullptr : &entries[found->second];
+        }
+
+        const void* pixels(const archive_entry& entry) const{return data + entry.pixel_offset;}
+
+        //No decode and no copy, SDL only reads from the surface
+        sdl2::Surface_ptr surface(const archive_entry& entry) const{
+            return sdl2::create_surface_from(const_cast<void*>(pixels(entry)),
+                    entry.width, entry.height, entry.pitch, header->pixel_format);
+        }
+};
+
+#endif
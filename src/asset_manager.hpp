@@ -1,17 +1,27 @@
 #ifndef ASSET_MANAGER_HPP
 #define ASSET_MANAGER_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
 #include <map>
+#include <memory>
 #include <string>
-
-#include <boost/uuid/uuid.hpp>
-#include <boost/uuid/uuid_generators.hpp>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <SDL2/SDL.h>
 
 #include "game_components.hpp"
 #include "sdl2_context.hpp"
+#include "asset_archive.hpp"
 #include "component_manager.hpp"
+#include "sprite_handle.hpp"
+#include "texture_atlas.hpp"
+#include "thread_pool.hpp"
 
 namespace asset_manager{
     /******************************************************************************/
@@ -19,23 +29,43 @@ namespace asset_manager{
     /******************************************************************************/
     using asset_id = component_id;
     using sprite_id = component_id;
+    //Tags are interned by the asset_manager, ids are small and dense
+    using tag_id = std::uint32_t;
+    using tag_list = std::vector<tag_id>;
 
     struct asset_component : game_component{
         std::string filename;
-        std::vector<std::string> tags;
+        //Sorted
+        tag_list tags;
         bool is_loaded;
         bool load_on_demand;
+        //Requested through the worker pool and not uploaded yet
+        bool is_loading;
+        //Set while the asset's pixels live in an atlas page instead of a
+        //texture of its own
+        asset_id atlas_id;
+        bool is_atlas;
+        //Residency cache bookkeeping, see asset_manager::set_texture_budget
+        std::size_t texture_bytes;
+        std::uint64_t last_used_frame;
+        bool is_pinned;
 
         asset_component(
                 asset_id id,
                 std::string filename, 
-                std::vector<std::string>& tags,
+                tag_list tags,
                 bool load_on_demand = false) : 
             game_component(id),
             filename(filename), 
             tags(tags), 
             is_loaded(false), 
-            load_on_demand(load_on_demand)
+            load_on_demand(load_on_demand),
+            is_loading(false),
+            atlas_id(),
+            is_atlas(false),
+            texture_bytes(0),
+            last_used_frame(0),
+            is_pinned(false)
         {}
     };
 
@@ -50,15 +80,24 @@ namespace asset_manager{
         std::string name;
         std::unique_ptr<SDL_Rect> clipping_rect;
         asset_id texture_id;
+        //The asset and rect the sprite was registered with. While the asset
+        //is packed, texture_id and clipping_rect point into its atlas.
+        asset_id source_id;
+        std::unique_ptr<SDL_Rect> source_rect;
+        sprite_handle handle;
 
         sprite_component(sprite_id id, 
                 std::string name, 
                 std::unique_ptr<SDL_Rect>&& clipping_rect,
-                asset_id texture_id) :
+                asset_id texture_id,
+                sprite_handle handle) :
             game_component(id),
             name(name), 
             clipping_rect(std::move(clipping_rect)),
-            texture_id(texture_id)
+            texture_id(texture_id),
+            source_id(texture_id),
+            source_rect(this->clipping_rect ? std::make_unique<SDL_Rect>(*this->clipping_rect) : nullptr),
+            handle(handle)
         {}
     };
 
@@ -88,6 +127,94 @@ namespace asset_manager{
             texture(texture), clipping_rect(std::move(clipping_rect)){}
     };
 
+    //Non-owning result of a handle lookup. The texture stays valid until
+    //its asset is unloaded or repacked, so views shouldn't outlive a frame.
+    struct sprite_view{
+        SDL_Texture* texture;
+        SDL_Rect clip;
+        bool has_clip;
+
+        const SDL_Rect* clipping_rect() const{return has_clip ? &clip : nullptr;}
+    };
+
+    //Flat copy of what drawing needs from a sprite, indexed by
+    //sprite_handle and kept in step with the sprite's component. The
+    //pointers are into the manager's pools, whose nodes don't move, so
+    //drawing reads the texture and loading state without a lookup.
+    struct sprite_slot{
+        sprite_id id;
+        asset_id texture_id;
+        asset_component* asset;
+        texture_component* texture;
+        SDL_Rect clip;
+        bool has_clip;
+    };
+
+    struct texture_cache_stats{
+        //Lookups that found their texture resident
+        std::size_t hits;
+        //Lookups that had to load, are waiting on a load or found nothing
+        std::size_t misses;
+        std::size_t evictions;
+    };
+
+    //Returned by loads, done once every asset the load covers is resident
+    //(or failed to load). Loads without a worker pool finish before they
+    //return. Copies share the same state.
+    class load_handle{
+        private:
+            std::shared_ptr<std::atomic<std::size_t>> remaining;
+
+        public:
+            load_handle() : remaining() {}
+            explicit load_handle(std::shared_ptr<std::atomic<std::size_t>> remaining) :
+                remaining(remaining) {}
+
+            bool done() const{return !remaining || *remaining == 0;}
+            std::size_t pending() const{return remaining ? remaining->load() : 0;}
+    };
+
+    struct decoded_asset{
+        asset_id id;
+        std::string filename;
+        //Null if decoding failed
+        sdl2::Surface_ptr surface;
+    };
+
+    //One texture's worth of a packed batch, composed before its upload
+    struct atlas_page{
+        sdl2::Surface_ptr surface;
+        //Where each asset sits on the page. A surface too big to share a
+        //page is a page of its own and becomes the asset's texture.
+        std::vector<std::pair<asset_id, SDL_Rect>> members;
+        bool is_shared;
+    };
+
+    //Assets requested together. Workers decode into their own slot of
+    //assets and the last one to finish composes a packed batch into pages,
+    //the render thread uploads once undecoded reaches 0.
+    struct load_batch{
+        std::vector<decoded_asset> assets;
+        //Decodes still to go, plus the composing step when packed
+        std::atomic<std::size_t> undecoded;
+        tag_list tags;
+        bool pack;
+        std::vector<atlas_page> pages;
+        //Packed assets that failed to decode, the render thread stops
+        //them loading
+        std::vector<asset_id> failed;
+        int page_size;
+        int padding;
+        //Next asset to upload, or next page when packed
+        std::size_t next_upload;
+        std::shared_ptr<std::atomic<std::size_t>> remaining;
+        //Decoded surfaces may point into it
+        std::shared_ptr<const mapped_archive> archive;
+        //What workers convert the decoded surfaces into
+        Uint32 pixel_format;
+        bool premultiply;
+    };
+
     class asset_manager{
         private:
             asset_manager_component_manager component_maps;
@@ -95,42 +222,168 @@ namespace asset_manager{
             id_generator generator;
             asset_index assets;
             sprite_index sprites;
+            std::vector<sprite_slot> sprite_table;
+            std::unordered_map<std::string, tag_id> tag_ids;
+            //Inverted index, the assets registered under each tag
+            std::vector<std::vector<asset_id>> tagged_assets;
+            //Assets currently holding a texture, atlas pages included
+            std::unordered_set<asset_id> resident;
+            int atlas_size;
+            int atlas_padding;
+            std::size_t atlas_count;
+            thread_pool* workers;
+            std::vector<std::shared_ptr<load_batch>> in_flight;
+            std::chrono::microseconds upload_budget;
+            sdl2::Texture_ptr placeholder;
+            std::shared_ptr<const mapped_archive> archive;
+            //Every surface is converted into upload_format before it
+            //becomes a texture
+            Uint32 upload_format;
+            bool premultiply_alpha;
+            std::size_t texture_budget;
+            std::size_t resident_bytes;
+            //Resident bytes of unpinned load_on_demand assets, the only
+            //ones evict_over_budget may unload
+            std::size_t evictable_bytes;
+            std::vector<std::pair<std::uint64_t, asset_id>> eviction_candidates;
+            std::uint64_t current_frame;
+            texture_cache_stats cache_stats;
 
             component_id generate_id(){return generator();}
             void load_asset(std::string filename);
             void load_texture(asset_id id);
-            void load_image_tags(
+            load_handle load_image_tags(
                     std::vector<std::string>& tags_to_load, 
                     bool unload_remaining = false);
             void unload_asset(std::string filename);
             void unload_texture(asset_id id);
-            bool has_matching_tags(
-                    std::vector<std::string>& first_tag_set, 
-                    std::vector<std::string>& second_tag_set);
+            static bool has_matching_tags(
+                    const tag_list& first_tag_set, 
+                    const tag_list& second_tag_set);
+            tag_id intern_tag(const std::string& tag);
+            //Ids of the tags that have been interned, sorted
+            tag_list find_tags(const std::vector<std::string>& tags) const;
+            static void compose_atlases(load_batch& batch);
+            static void compose_pages(load_batch& batch);
+            void upload_atlas_page(
+                    atlas_page& page,
+                    const tag_list& tags,
+                    bool premultiplied);
+            void dissolve_atlas(asset_id id);
+            static sdl2::Surface_ptr load_surface(
+                    const std::string& filename,
+                    const mapped_archive* archive,
+                    Uint32 format,
+                    bool premultiply);
+            static void decode(decoded_asset& asset, const load_batch& batch);
+            sdl2::Texture_ptr make_texture(SDL_Surface* prepared_surface, bool premultiplied);
+            void start_loading(
+                    std::vector<asset_id>& asset_ids,
+                    const tag_list& tags,
+                    bool pack,
+                    std::shared_ptr<std::atomic<std::size_t>>& remaining);
+            bool finish_batch(load_batch& batch, std::chrono::steady_clock::time_point deadline);
+            SDL_Texture* placeholder_texture();
+            void sync_slot(const sprite_component& sprite);
+            void set_texture(asset_id id, sdl2::Texture_ptr texture);
+            void touch(asset_component& asset, bool resident);
+            static bool is_evictable(const asset_component& asset){return asset.load_on_demand && !asset.is_pinned;}
+            void evict_over_budget();
 
         public:
             asset_manager(sdl2::Renderer_shared renderer) :
-                component_maps(), renderer(renderer), generator(), assets(), sprites(){}
-            void register_sprite(
+                component_maps(), renderer(renderer), generator(), assets(), sprites(), sprite_table(),
+                tag_ids(), tagged_assets(), resident(),
+                atlas_size(2048), atlas_padding(1), atlas_count(0),
+                workers(nullptr), in_flight(), upload_budget(2000), placeholder(), archive(),
+                upload_format(sdl2::native_texture_format(renderer.get())), premultiply_alpha(false),
+                texture_budget(0), resident_bytes(0), evictable_bytes(0), eviction_candidates(),
+                current_frame(0), cache_stats{0, 0, 0}{}
+
+            //Assets loaded through load_asset_tags are packed into atlas
+            //pages of up to size x size pixels, a size of 0 turns packing off
+            void set_atlas_size(int size, int padding = 1){
+                atlas_size = size;
+                atlas_padding = padding;
+            }
+
+            //Returns the handle of the new sprite, or of the existing one if
+            //sprite_name is already registered
+            sprite_handle register_sprite(
                     std::string sprite_name, 
                     std::string filename,
                     std::unique_ptr<SDL_Rect> clipping_rect = nullptr,
                     std::vector<std::string> tags = {},
                     bool load_on_demand = false);
 
-            void load_sprite(std::string sprite_name);
+            //Once set, loads decode and compose atlas pages on pool, and
+            //upload_pending() only uploads them on the render thread. The
+            //pool has to outlive the loads.
+            void use_workers(thread_pool& pool){workers = &pool;}
+            //Time upload_pending() may spend per call, at least one asset
+            //or atlas page is uploaded per call regardless
+            void set_upload_budget(std::chrono::microseconds budget){upload_budget = budget;}
+            //Drawn instead of sprites whose asset is still loading, a 1x1
+            //magenta texture by default
+            void set_placeholder(sdl2::Texture_ptr texture){placeholder = texture;}
+
+            //Caps the bytes (width x height x bytes per pixel) held by
+            //textures, 0 means no cap. Once over budget begin_frame()
+            //unloads the least recently drawn load_on_demand assets that
+            //aren't pinned, they come back on their next get_sprite. Tag
+            //loaded assets count towards the budget but are only released
+            //by tag loads.
+            void set_texture_budget(std::size_t bytes){texture_budget = bytes;}
+            std::size_t get_resident_bytes() const{return resident_bytes;}
+            //Keeps the sprite's asset resident regardless of the budget
+            void pin_sprite(sprite_handle sprite, bool pinned = true);
+            //Call once per frame before any get_sprite, evicts down to the
+            //budget. Textures looked up during the frame stay alive until
+            //the next call.
+            void begin_frame();
+            const texture_cache_stats& get_cache_stats() const{return cache_stats;}
+            void reset_cache_stats(){cache_stats = texture_cache_stats{0, 0, 0};}
 
-            void load_asset_tags(
+            //Null handle if sprite_name isn't registered
+            sprite_handle find_sprite(const std::string& sprite_name);
+
+            //Files packed into the archive (see asset_packer.cpp) are loaded
+            //from its pre-decoded pixels instead of through SDL_image,
+            //anything else still loads from disk, as do all of them when the
+            //archive's premultiplication (asset_packer -p) doesn't match
+            //set_premultiplied_alpha. False if path can't be mapped, the
+            //previous archive is kept then.
+            bool use_archive(const std::string& path);
+
+            //Stores loaded textures with their color multiplied by alpha and
+            //draws them with the matching blend mode, which filters without
+            //dark fringes and blends with one multiply less. Only affects
+            //loads started afterwards. False if SDL or the renderer can't
+            //do it, it stays off then.
+            bool set_premultiplied_alpha(bool enabled);
+            Uint32 get_upload_format() const{return upload_format;}
+
+            load_handle load_sprite(std::string sprite_name);
+            load_handle load_sprite(sprite_handle sprite);
+
+            load_handle load_asset_tags(
                     std::vector<std::string> tags_to_load, 
                     bool unload_remaining = false);
+            //Uploads decoded assets within the budget, call once per frame
+            //from the render thread. Returns how many loads are still in
+            //flight.
+            std::size_t upload_pending();
             sprite_asset get_sprite(std::string sprite_name);
+            //Allocation and lookup free for the draw path, same loading
+            //rules as get_sprite. A null handle gets the placeholder.
+            sprite_view get_sprite(sprite_handle sprite);
             void unload_all();
     };
 
     /******************************************************************************/
     /*                         Asset Manager Definitions                          */
     /******************************************************************************/
-    void asset_manager::register_sprite(
+    sprite_handle asset_manager::register_sprite(
             std::string sprite_name, 
             std::string filename,
             std::unique_ptr<SDL_Rect> clipping_rect, 
@@ -146,20 +399,22 @@ namespace asset_manager{
         if(sprite_exists){
             std::cout << "Warning - sprite name \"" 
                 << sprite_name << "\" already exists" << std::endl;
-            return;
+            return find_sprite(sprite_name);
         }
 
-        auto& asset_pool = component_maps.template get<asset_component>();
-        auto& texture_pool = component_maps.template get<texture_component>();
-
         //It's alright if many sprites may reference the same asset so
         //it's not a big deal if it already exists, but the asset
         //itself needs to be created if it doesn't already exist
         if(!asset_exists){
             asset_id id_of_asset = generate_id();
-            auto pool_emplace_asset = make_emplace_id(id_of_asset);
-            pool_emplace_asset(asset_pool, filename, tags, load_on_demand);
-            pool_emplace_asset(texture_pool, nullptr);
+            tag_list asset_tags;
+            for(auto& tag : tags) asset_tags.push_back(intern_tag(tag));
+            std::sort(std::begin(asset_tags), std::end(asset_tags));
+            asset_tags.erase(std::unique(std::begin(asset_tags), std::end(asset_tags)), std::end(asset_tags));
+            for(auto tag : asset_tags) tagged_assets[tag].push_back(id_of_asset);
+
+            component_maps.template emplace<asset_component>(id_of_asset, filename, std::move(asset_tags), load_on_demand);
+            component_maps.template emplace<texture_component>(id_of_asset, nullptr);
             assets[filename] = id_of_asset;
         }
 
@@ -168,34 +423,428 @@ namespace asset_manager{
         asset_id id_of_asset = assets.at(filename);
         sprite_id id_of_sprite = generate_id();
 
-        auto& sprite_pool = component_maps.template get<sprite_component>();
-        auto pool_emplace_sprite = make_emplace_id(id_of_sprite);
-
-        pool_emplace_sprite(sprite_pool, sprite_name, std::move(clipping_rect), id_of_asset);
+        sprite_handle handle(static_cast<std::uint32_t>(sprite_table.size()));
+        component_maps.template emplace<sprite_component>(id_of_sprite, sprite_name, std::move(clipping_rect), id_of_asset, handle);
         sprites[sprite_name] = id_of_sprite;
+
+        sprite_table.push_back(sprite_slot{id_of_sprite, id_of_asset, nullptr, nullptr, SDL_Rect{0, 0, 0, 0}, false});
+        sync_slot(component_maps.template get<sprite_component>().at(id_of_sprite));
+        return handle;
     }
 
-    void asset_manager::load_asset_tags(
+    tag_id asset_manager::intern_tag(const std::string& tag){
+        auto found = tag_ids.find(tag);
+        if(found != std::end(tag_ids)) return found->second;
+
+        auto id = static_cast<tag_id>(tagged_assets.size());
+        tag_ids.emplace(tag, id);
+        tagged_assets.emplace_back();
+        return id;
+    }
+
+    tag_list asset_manager::find_tags(const std::vector<std::string>& tags) const{
+        tag_list found_tags;
+        for(auto& tag : tags){
+            auto found = tag_ids.find(tag);
+            if(found != std::end(tag_ids)) found_tags.push_back(found->second);
+        }
+        std::sort(std::begin(found_tags), std::end(found_tags));
+        found_tags.erase(std::unique(std::begin(found_tags), std::end(found_tags)), std::end(found_tags));
+        return found_tags;
+    }
+
+    sprite_handle asset_manager::find_sprite(const std::string& sprite_name){
+        auto found = sprites.find(sprite_name);
+        if(found == std::end(sprites)) return sprite_handle();
+        return component_maps.template get<sprite_component>().at(found->second).handle;
+    }
+
+    void asset_manager::sync_slot(const sprite_component& sprite){
+        auto& slot = sprite_table[sprite.handle.index];
+        slot.texture_id = sprite.texture_id;
+        slot.asset = &component_maps.template get<asset_component>().at(sprite.texture_id);
+        slot.texture = &component_maps.template get<texture_component>().at(sprite.texture_id);
+        slot.has_clip = sprite.clipping_rect != nullptr;
+        slot.clip = slot.has_clip ? *sprite.clipping_rect : SDL_Rect{0, 0, 0, 0};
+    }
+
+    load_handle asset_manager::load_asset_tags(
             std::vector<std::string> tags_to_load,
             bool unload_remaining){
-        load_image_tags(tags_to_load, unload_remaining);
+        return load_image_tags(tags_to_load, unload_remaining);
     }
 
-    void asset_manager::load_image_tags(
+    //Matching assets that aren't loaded yet are packed into atlas pages
+    //together (unless packing is off or they load on demand). Atlases built
+    //for other tags are taken apart first when unload_remaining is set.
+    //Only the assets filed under the requested tags and, when unloading,
+    //the resident ones are visited.
+    load_handle asset_manager::load_image_tags(
             std::vector<std::string>& tags_to_load, 
             bool unload_remaining){
 
-        for(auto& asset_pair : assets){
-            auto& asset_pool = component_maps.template get<asset_component>();
-            auto id_of_asset = asset_pair.second;
+        auto& asset_pool = component_maps.template get<asset_component>();
+        auto wanted_tags = find_tags(tags_to_load);
+
+        if(unload_remaining){
+            std::vector<asset_id> stale_atlases;
+            std::vector<asset_id> stale_assets;
+            for(auto id_of_asset : resident){
+                auto& asset = asset_pool.at(id_of_asset);
+                if(has_matching_tags(wanted_tags, asset.tags)) continue;
+                if(asset.is_atlas) stale_atlases.push_back(id_of_asset);
+                else stale_assets.push_back(id_of_asset);
+            }
+            for(auto id_of_atlas : stale_atlases) dissolve_atlas(id_of_atlas);
+            for(auto id_of_asset : stale_assets) unload_texture(id_of_asset);
+            //Loads still in flight for other tags are dropped as well
+            for(auto& batch : in_flight){
+                for(auto& decoded : batch->assets){
+                    auto& asset = asset_pool.at(decoded.id);
+                    if(asset.is_loading && !has_matching_tags(wanted_tags, asset.tags)) unload_texture(decoded.id);
+                }
+            }
+        }
+
+        //An asset under several of the tags is listed once per tag
+        std::vector<asset_id> matching;
+        for(auto tag : wanted_tags){
+            auto& tagged = tagged_assets[tag];
+            matching.insert(std::end(matching), std::begin(tagged), std::end(tagged));
+        }
+        if(wanted_tags.size() > 1){
+            std::sort(std::begin(matching), std::end(matching));
+            matching.erase(std::unique(std::begin(matching), std::end(matching)), std::end(matching));
+        }
+
+        std::vector<asset_id> to_pack;
+        std::vector<asset_id> to_load;
+        for(auto id_of_asset : matching){
+            auto& asset = asset_pool.at(id_of_asset);
+            if(asset.is_loaded || asset.is_loading) continue;
+            if(atlas_size > 0 && !asset.load_on_demand) to_pack.push_back(id_of_asset);
+            else to_load.push_back(id_of_asset);
+        }
+
+        auto remaining = std::make_shared<std::atomic<std::size_t>>(0);
+        start_loading(to_pack, wanted_tags, true, remaining);
+        start_loading(to_load, wanted_tags, false, remaining);
+        return load_handle(remaining);
+    }
+
+    //Decoded and ready for make_texture. Archived pixels are only used if
+    //they were premultiplied the same way, multiplying can't be undone.
+    sdl2::Surface_ptr asset_manager::load_surface(
+            const std::string& filename,
+            const mapped_archive* archive,
+            Uint32 format,
+            bool premultiply){
+        if(archive && archive->is_premultiplied() == premultiply){
+            if(auto entry = archive->find(filename)) return sdl2::prepare_surface(archive->surface(*entry), format);
+        }
+        return sdl2::prepare_surface(sdl2::basic_img_load(filename.c_str()), format, premultiply);
+    }
+
+    //Converting here keeps it off the render thread
+    void asset_manager::decode(decoded_asset& asset, const load_batch& batch){
+        try{
+            asset.surface = load_surface(asset.filename, batch.archive.get(), batch.pixel_format, batch.premultiply);
+        }
+        catch(const std::exception& error){
+            std::cout << "Warning - failed to load asset filename[" << asset.filename << "]" << std::endl
+                << error.what() << std::endl;
+            asset.surface = nullptr;
+        }
+    }
+
+    //Without workers everything is decoded and uploaded right away
+    void asset_manager::start_loading(
+            std::vector<asset_id>& asset_ids,
+            const tag_list& tags,
+            bool pack,
+            std::shared_ptr<std::atomic<std::size_t>>& remaining){
+        if(asset_ids.empty()) return;
+
+        auto& asset_pool = component_maps.template get<asset_component>();
+        auto batch = std::make_shared<load_batch>();
+        batch->undecoded = asset_ids.size() + (pack ? 1 : 0);
+        batch->tags = tags;
+        batch->pack = pack;
+        batch->page_size = atlas_size;
+        batch->padding = atlas_padding;
+        batch->next_upload = 0;
+        batch->remaining = remaining;
+        batch->archive = archive;
+        batch->pixel_format = upload_format;
+        batch->premultiply = premultiply_alpha;
+        *remaining += asset_ids.size();
+
+        SDL_RendererInfo info;
+        if(pack && SDL_GetRendererInfo(renderer.get(), &info) == 0 && info.max_texture_width > 0){
+            batch->page_size = std::min({batch->page_size, info.max_texture_width, info.max_texture_height});
+        }
+
+        for(auto id_of_asset : asset_ids){
             auto& asset = asset_pool.at(id_of_asset);
-            if(!asset.is_loaded && has_matching_tags(tags_to_load, asset.tags)){
-                load_asset(asset.filename);
+            asset.is_loading = true;
+            batch->assets.push_back(decoded_asset{id_of_asset, asset.filename, nullptr});
+        }
+
+        if(!workers){
+            for(auto& asset : batch->assets) decode(asset, *batch);
+            if(pack) compose_atlases(*batch);
+            batch->undecoded = 0;
+            finish_batch(*batch, std::chrono::steady_clock::time_point::max());
+            return;
+        }
+
+        for(std::size_t i = 0; i < batch->assets.size(); ++i){
+            workers->submit([batch, i]{
+                decode(batch->assets[i], *batch);
+                //The composing step keeps undecoded above 0 until the
+                //pages are ready
+                auto left = --batch->undecoded;
+                if(batch->pack && left == 1){
+                    compose_atlases(*batch);
+                    --batch->undecoded;
+                }
+            });
+        }
+        in_flight.push_back(batch);
+    }
+
+    //Returns false if the deadline passed before the batch was done.
+    //Assets unloaded while they were loading are dropped.
+    bool asset_manager::finish_batch(load_batch& batch, std::chrono::steady_clock::time_point deadline){
+        auto& asset_pool = component_maps.template get<asset_component>();
+
+        bool uploaded_any = false;
+        if(batch.pack){
+            //Pages are composed already, each one is its own upload
+            for(auto id_of_asset : batch.failed){
+                asset_pool.at(id_of_asset).is_loading = false;
             }
-            else if(unload_remaining){
-                unload_asset(asset.filename);
+            *batch.remaining -= batch.failed.size();
+            batch.failed.clear();
+
+            while(batch.next_upload < batch.pages.size()){
+                if(uploaded_any && std::chrono::steady_clock::now() >= deadline) return false;
+
+                auto& page = batch.pages[batch.next_upload++];
+                upload_atlas_page(page, batch.tags, batch.premultiply);
+                *batch.remaining -= page.members.size();
+                page.surface = nullptr;
+                uploaded_any = true;
+            }
+            return true;
+        }
+
+        while(batch.next_upload < batch.assets.size()){
+            if(uploaded_any && std::chrono::steady_clock::now() >= deadline) return false;
+
+            auto& decoded = batch.assets[batch.next_upload++];
+            auto& asset = asset_pool.at(decoded.id);
+            if(asset.is_loading && decoded.surface){
+                set_texture(decoded.id, make_texture(decoded.surface.get(), batch.premultiply));
+                asset.is_loaded = true;
+                uploaded_any = true;
             }
+            asset.is_loading = false;
+            decoded.surface = nullptr;
+            --*batch.remaining;
         }
+        return true;
+    }
+
+    std::size_t asset_manager::upload_pending(){
+        auto deadline = std::chrono::steady_clock::now() + upload_budget;
+        for(auto batch = std::begin(in_flight); batch != std::end(in_flight); ){
+            if((*batch)->undecoded != 0){
+                ++batch;
+                continue;
+            }
+            if(!finish_batch(**batch, deadline)) break;
+            batch = in_flight.erase(batch);
+            if(std::chrono::steady_clock::now() >= deadline) break;
+        }
+        return in_flight.size();
+    }
+
+    SDL_Texture* asset_manager::placeholder_texture(){
+        if(!placeholder){
+            auto surface = sdl2::create_surface(1, 1, SDL_PIXELFORMAT_RGBA32);
+            auto pixel = static_cast<Uint8*>(surface->pixels);
+            pixel[0] = 0xFF;
+            pixel[1] = 0x00;
+            pixel[2] = 0xFF;
+            pixel[3] = 0xFF;
+            placeholder = sdl2::create_texture_from_surface(renderer.get(), surface.get());
+        }
+        return placeholder.get();
+    }
+
+    //Packs the decoded surfaces into batch.pages and blits them, nothing is
+    //uploaded yet. Runs on a worker, so it only touches the batch. The
+    //assets stay loading until their page is uploaded.
+    void asset_manager::compose_atlases(load_batch& batch){
+        try{
+            compose_pages(batch);
+        }
+        catch(const std::exception& error){
+            std::cout << "Warning - failed to compose atlas pages" << std::endl
+                << error.what() << std::endl;
+            batch.pages.clear();
+            batch.failed.clear();
+            for(auto& decoded : batch.assets) batch.failed.push_back(decoded.id);
+        }
+        for(auto& decoded : batch.assets) decoded.surface = nullptr;
+    }
+
+    void asset_manager::compose_pages(load_batch& batch){
+        int page_size = batch.page_size;
+        int atlas_padding = batch.padding;
+
+        struct packed_surface{
+            asset_id id;
+            sdl2::Surface_ptr surface;
+            SDL_Rect placement;
+            std::size_t page;
+        };
+
+        //Packed tallest first
+        auto& pages = batch.pages;
+        std::vector<packed_surface> surfaces;
+        for(auto& source : batch.assets){
+            auto id_of_asset = source.id;
+            auto& surface = source.surface;
+            if(!surface){
+                batch.failed.push_back(id_of_asset);
+                continue;
+            }
+            if(surface->w + atlas_padding > page_size || surface->h + atlas_padding > page_size){
+                //Too big to share a page, it gets a texture of its own
+                pages.push_back(atlas_page{surface, {std::make_pair(id_of_asset, SDL_Rect{0, 0, surface->w, surface->h})}, false});
+                continue;
+            }
+            surfaces.push_back(packed_surface{id_of_asset, surface, SDL_Rect{0, 0, 0, 0}, 0});
+        }
+        std::sort(std::begin(surfaces), std::end(surfaces), [](const packed_surface& lhs, const packed_surface& rhs){
+            if(lhs.surface->h != rhs.surface->h) return lhs.surface->h > rhs.surface->h;
+            return lhs.surface->w > rhs.surface->w;
+        });
+
+        std::vector<skyline_packer> packers;
+        for(auto& packed : surfaces){
+            std::size_t page = 0;
+            while(page < packers.size() && !packers[page].pack(packed.surface->w, packed.surface->h, packed.placement)){
+                ++page;
+            }
+            if(page == packers.size()){
+                packers.emplace_back(page_size, page_size, atlas_padding);
+                packers.back().pack(packed.surface->w, packed.surface->h, packed.placement);
+            }
+            packed.page = page;
+        }
+
+        for(std::size_t page = 0; page < packers.size(); ++page){
+            //Sources are already in pixel_format, blitting them is a copy
+            atlas_page composed{sdl2::create_surface(page_size, packers[page].get_used_height(), batch.pixel_format), {}, true};
+            for(auto& packed : surfaces){
+                if(packed.page != page) continue;
+                SDL_Rect target = packed.placement;
+                SDL_SetSurfaceBlendMode(packed.surface.get(), SDL_BLENDMODE_NONE);
+                SDL_BlitSurface(packed.surface.get(), nullptr, composed.surface.get(), &target);
+                composed.members.push_back(std::make_pair(packed.id, packed.placement));
+            }
+            pages.push_back(std::move(composed));
+        }
+    }
+
+    //Every shared page becomes an asset of its own. Assets unloaded since
+    //the page was composed are left out.
+    void asset_manager::upload_atlas_page(
+            atlas_page& page,
+            const tag_list& tags,
+            bool premultiplied){
+
+        auto& asset_pool = component_maps.template get<asset_component>();
+        auto& sprite_pool = component_maps.template get<sprite_component>();
+
+        std::map<asset_id, SDL_Rect> placements;
+        for(auto& member : page.members){
+            if(asset_pool.at(member.first).is_loading) placements.insert(member);
+        }
+        if(placements.empty()) return;
+
+        if(!page.is_shared){
+            auto id_of_asset = std::begin(placements)->first;
+            auto& asset = asset_pool.at(id_of_asset);
+            set_texture(id_of_asset, make_texture(page.surface.get(), premultiplied));
+            asset.is_loading = false;
+            asset.is_loaded = true;
+            return;
+        }
+
+        asset_id id_of_atlas = generate_id();
+        std::string atlas_name = "#atlas" + std::to_string(atlas_count++);
+        component_maps.template emplace<asset_component>(id_of_atlas, atlas_name, tags, false);
+        component_maps.template emplace<texture_component>(id_of_atlas, nullptr);
+        set_texture(id_of_atlas, make_texture(page.surface.get(), premultiplied));
+        auto& atlas = asset_pool.at(id_of_atlas);
+        atlas.is_loaded = true;
+        atlas.is_atlas = true;
+        assets[atlas_name] = id_of_atlas;
+
+        for(auto& placement : placements){
+            auto& asset = asset_pool.at(placement.first);
+            asset.atlas_id = id_of_atlas;
+            asset.is_loading = false;
+            asset.is_loaded = true;
+        }
+
+        //Point every sprite of a packed asset into the page
+        for(auto& sprite_pair : sprite_pool){
+            auto& sprite = sprite_pair.second;
+            auto found = placements.find(sprite.source_id);
+            if(found == std::end(placements)) continue;
+
+            SDL_Rect rect = found->second;
+            if(sprite.source_rect){
+                rect.x += sprite.source_rect->x;
+                rect.y += sprite.source_rect->y;
+                rect.w = sprite.source_rect->w;
+                rect.h = sprite.source_rect->h;
+            }
+            sprite.texture_id = id_of_atlas;
+            sprite.clipping_rect = std::make_unique<SDL_Rect>(rect);
+            sync_slot(sprite);
+        }
+    }
+
+    //Sends the atlas's sprites back to their own assets (unloaded) and
+    //frees the page
+    void asset_manager::dissolve_atlas(asset_id id){
+        auto& asset_pool = component_maps.template get<asset_component>();
+        auto& sprite_pool = component_maps.template get<sprite_component>();
+
+        for(auto& sprite_pair : sprite_pool){
+            auto& sprite = sprite_pair.second;
+            if(sprite.texture_id != id) continue;
+            sprite.texture_id = sprite.source_id;
+            sprite.clipping_rect = sprite.source_rect ? std::make_unique<SDL_Rect>(*sprite.source_rect) : nullptr;
+            sync_slot(sprite);
+        }
+        for(auto& asset_pair : asset_pool){
+            auto& asset = asset_pair.second;
+            if(asset.atlas_id != id) continue;
+            asset.atlas_id = asset_id();
+            asset.is_loaded = false;
+        }
+
+        set_texture(id, nullptr);
+        assets.erase(asset_pool.at(id).filename);
+        component_maps.destroy(id);
+        generator.release(id);
     }
 
     void asset_manager::unload_asset(std::string filename){
@@ -204,29 +853,47 @@ namespace asset_manager{
         unload_texture(id_of_asset);
     }
 
+    //Packed assets are only unloaded with their whole atlas
     void asset_manager::unload_texture(asset_id id){
         auto& asset_pool = component_maps.template get<asset_component>();
         auto& asset = asset_pool.at(id);
-        if(asset.is_loaded){
-            auto& texture_pool = component_maps.template get<texture_component>();
-            auto& texture = texture_pool.at(id);
-            texture.texture = nullptr;
+        //A pending upload is dropped when its batch finishes
+        asset.is_loading = false;
+        if(asset.is_loaded && asset.atlas_id.is_null()){
+            set_texture(id, nullptr);
             asset.is_loaded = false;
         }
     }
 
+    //Both sets are sorted
     bool asset_manager::has_matching_tags(
-            std::vector<std::string>& first_tag_set, std::vector<std::string>& second_tag_set){
-        return (find_first_of(std::begin(first_tag_set), std::end(first_tag_set), 
-                    std::begin(second_tag_set), std::end(second_tag_set)) 
-                != std::end(first_tag_set));
+            const tag_list& first_tag_set, const tag_list& second_tag_set){
+        auto first = std::begin(first_tag_set);
+        auto second = std::begin(second_tag_set);
+        while(first != std::end(first_tag_set) && second != std::end(second_tag_set)){
+            if(*first < *second) ++first;
+            else if(*second < *first) ++second;
+            else return true;
+        }
+        return false;
     }
 
-    void asset_manager::load_sprite(std::string sprite_name){
+    load_handle asset_manager::load_sprite(std::string sprite_name){
         auto id_of_sprite = sprites.at(sprite_name);
         auto& sprite_pool = component_maps.template get<sprite_component>();
-        auto& sprite = sprite_pool.at(id_of_sprite);
-        load_texture(sprite.texture_id);
+        return load_sprite(sprite_pool.at(id_of_sprite).handle);
+    }
+    load_handle asset_manager::load_sprite(sprite_handle sprite){
+        auto& asset_pool = component_maps.template get<asset_component>();
+        auto id_of_texture = sprite_table.at(sprite.index).texture_id;
+        auto& asset = asset_pool.at(id_of_texture);
+        if(asset.is_loaded || asset.is_loading) return load_handle();
+
+        std::vector<asset_id> to_load{id_of_texture};
+        tag_list no_tags;
+        auto remaining = std::make_shared<std::atomic<std::size_t>>(0);
+        start_loading(to_load, no_tags, false, remaining);
+        return load_handle(remaining);
     }
 
     void asset_manager::load_asset(std::string filename){
@@ -236,7 +903,7 @@ namespace asset_manager{
 
         if(!asset.is_loaded){
             auto contains_id = make_contains(id_of_asset);
-            auto& texture_pool = component_maps.template get<sprite_component>();
+            auto& texture_pool = component_maps.template get<texture_component>();
             if(contains_id(texture_pool)){
                 load_texture(id_of_asset);
             }
@@ -255,7 +922,8 @@ namespace asset_manager{
         auto& texture = texture_pool.at(id);
 
         if(!asset.is_loaded || texture.texture == nullptr){
-            texture.texture = sdl2::load_texture(renderer.get(), asset.filename.c_str());
+            auto surface = load_surface(asset.filename, archive.get(), upload_format, premultiply_alpha);
+            set_texture(id, make_texture(surface.get(), premultiply_alpha));
             asset.is_loaded = true;
         }
     }
@@ -272,6 +940,16 @@ namespace asset_manager{
         auto& texture = texture_pool.at(id_of_texture);
         auto& asset = asset_pool.at(id_of_texture);
 
+        touch(asset, texture.texture != nullptr);
+        if(asset.is_loading){
+            placeholder_texture();
+            return sprite_asset(placeholder, nullptr);
+        }
+        if(asset.load_on_demand && workers && texture.texture == nullptr){
+            load_sprite(sprite_name);
+            placeholder_texture();
+            return sprite_asset(placeholder, nullptr);
+        }
         if(!asset.load_on_demand && texture.texture == nullptr){
             std::cout << "Warning - texture for sprite_name[" << sprite_name << "] is not loaded correctly" << std::endl;
         }
@@ -289,6 +967,12 @@ namespace asset_manager{
         auto& asset_pool = component_maps.template get<asset_component>();
         auto& texture_pool = component_maps.template get<texture_component>();
 
+        std::vector<asset_id> atlases;
+        for(auto& asset_pair : asset_pool){
+            if(asset_pair.second.is_atlas) atlases.push_back(asset_pair.first);
+        }
+        for(auto id_of_atlas : atlases) dissolve_atlas(id_of_atlas);
+
         for(auto& texture_pair : texture_pool){
             auto& texture = texture_pair.second;
             texture.texture = nullptr;
@@ -297,7 +981,147 @@ namespace asset_manager{
         for(auto& asset_pair : asset_pool){
             auto& asset = asset_pair.second;
             asset.is_loaded = false;
+            asset.texture_bytes = 0;
+        }
+        resident_bytes = 0;
+        evictable_bytes = 0;
+        resident.clear();
+    }
+
+    //Null and unknown handles get the placeholder
+    sprite_view asset_manager::get_sprite(sprite_handle sprite){
+        if(sprite.index >= sprite_table.size()){
+            return sprite_view{placeholder_texture(), SDL_Rect{0, 0, 0, 0}, false};
+        }
+        auto& slot = sprite_table[sprite.index];
+        auto& asset = *slot.asset;
+        auto& texture = *slot.texture;
+
+        touch(asset, texture.texture != nullptr);
+        if(asset.is_loading){
+            return sprite_view{placeholder_texture(), SDL_Rect{0, 0, 0, 0}, false};
+        }
+        if(asset.load_on_demand && texture.texture == nullptr){
+            if(workers){
+                load_sprite(sprite);
+                return sprite_view{placeholder_texture(), SDL_Rect{0, 0, 0, 0}, false};
+            }
+            load_texture(slot.texture_id);
+        }
+        else if(texture.texture == nullptr){
+            std::cout << "Warning - texture for sprite_name["
+                << component_maps.template get<sprite_component>().at(slot.id).name
+                << "] is not loaded correctly" << std::endl;
+        }
+        return sprite_view{texture.texture.get(), slot.clip, slot.has_clip};
+    }
+
+    void asset_manager::set_texture(asset_id id, sdl2::Texture_ptr texture){
+        auto& asset_pool = component_maps.template get<asset_component>();
+        auto& texture_pool = component_maps.template get<texture_component>();
+        auto& asset = asset_pool.at(id);
+
+        resident_bytes -= asset.texture_bytes;
+        if(is_evictable(asset)) evictable_bytes -= asset.texture_bytes;
+        asset.texture_bytes = 0;
+        if(texture){
+            Uint32 format = 0;
+            int width = 0, height = 0;
+            if(SDL_QueryTexture(texture.get(), &format, nullptr, &width, &height) == 0){
+                asset.texture_bytes = static_cast<std::size_t>(width) * height * SDL_BYTESPERPIXEL(format);
+            }
+        }
+        resident_bytes += asset.texture_bytes;
+        if(is_evictable(asset)) evictable_bytes += asset.texture_bytes;
+        texture_pool.at(id).texture = texture;
+        if(texture) resident.insert(id);
+        else resident.erase(id);
+    }
+
+    void asset_manager::touch(asset_component& asset, bool resident){
+        asset.last_used_frame = current_frame;
+        if(resident && !asset.is_loading) ++cache_stats.hits;
+        else ++cache_stats.misses;
+    }
+
+    void asset_manager::pin_sprite(sprite_handle sprite, bool pinned){
+        auto& asset_pool = component_maps.template get<asset_component>();
+        auto& sprite_pool = component_maps.template get<sprite_component>();
+        auto id_of_sprite = sprite_table.at(sprite.index).id;
+        auto& asset = asset_pool.at(sprite_pool.at(id_of_sprite).source_id);
+        if(is_evictable(asset)) evictable_bytes -= asset.texture_bytes;
+        asset.is_pinned = pinned;
+        if(is_evictable(asset)) evictable_bytes += asset.texture_bytes;
+    }
+
+    void asset_manager::begin_frame(){
+        ++current_frame;
+        //Tag loaded bytes alone can keep it over budget, there is nothing
+        //to look for then
+        if(texture_budget > 0 && resident_bytes > texture_budget && evictable_bytes > 0) evict_over_budget();
+    }
+
+    //Least recently drawn first, anything drawn last frame is kept. Only
+    //assets holding a texture are visited.
+    void asset_manager::evict_over_budget(){
+        auto& asset_pool = component_maps.template get<asset_component>();
+
+        auto& candidates = eviction_candidates;
+        candidates.clear();
+        for(auto id_of_asset : resident){
+            auto& asset = asset_pool.at(id_of_asset);
+            if(!is_evictable(asset) || asset.texture_bytes == 0) continue;
+            if(asset.last_used_frame + 1 >= current_frame) continue;
+            candidates.emplace_back(asset.last_used_frame, id_of_asset);
+        }
+        std::sort(std::begin(candidates), std::end(candidates));
+
+        for(auto& candidate : candidates){
+            if(resident_bytes <= texture_budget) break;
+            unload_texture(candidate.second);
+            ++cache_stats.evictions;
+        }
+    }
+
+    bool asset_manager::use_archive(const std::string& path){
+        try{
+            archive = std::make_shared<const mapped_archive>(path);
+        }
+        catch(const std::exception& error){
+            std::cout << "Warning - " << error.what() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    //prepared_surface has to be in upload_format already
+    sdl2::Texture_ptr asset_manager::make_texture(SDL_Surface* prepared_surface, bool premultiplied){
+        auto texture = sdl2::create_texture_from_surface(renderer.get(), prepared_surface);
+        if(premultiplied) SDL_SetTextureBlendMode(texture.get(), sdl2::premultiplied_blend_mode());
+        return texture;
+    }
+
+    bool asset_manager::set_premultiplied_alpha(bool enabled){
+        if(!enabled || !sdl2::premultiply_supported || !SDL_ISPIXELFORMAT_ALPHA(upload_format)){
+            premultiply_alpha = false;
+            return !enabled;
+        }
+
+        //Custom blend modes are optional for renderers, try it on a texture
+        //that's around anyway
+        auto probe = placeholder_texture();
+        SDL_BlendMode previous_mode = SDL_BLENDMODE_BLEND;
+        SDL_GetTextureBlendMode(probe, &previous_mode);
+        bool blend_supported = SDL_SetTextureBlendMode(probe, sdl2::premultiplied_blend_mode()) == 0;
+        SDL_SetTextureBlendMode(probe, previous_mode);
+        if(!blend_supported){
+            std::cout << "Warning - renderer can't blend premultiplied alpha" << std::endl
+                << "Error: " << SDL_GetError() << std::endl;
+            premultiply_alpha = false;
+            return false;
         }
+        premultiply_alpha = true;
+        return true;
     }
 }
 
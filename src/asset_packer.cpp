@@ -0,0 +1,177 @@
+//Offline tool that decodes images once and writes them into an asset
+//archive (see asset_archive.hpp) for asset_manager::use_archive:
+//make packer
+//./asset_packer.out [-f FORMAT] [-p] Assets/assets.pak Assets/loaded.png ...
+//Entries are named after the paths exactly as given, so pass them the same
+//way they are registered with asset_manager::register_sprite. Without -f
+//the pixels are stored in the format asset_manager uploads in on this
+//machine (sdl2::native_texture_format of the default renderer),
+//FORMAT is an SDL_PixelFormatEnum name without its prefix, e.g. ARGB8888.
+//-p stores the pixels premultiplied for asset_manager::set_premultiplied_alpha,
+//the archive records it so they aren't multiplied again at load.
+
+//STD Headers
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//SDL_Headers
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+//Local Headers
+#include "sdl2_context.hpp"
+#include "asset_archive.hpp"
+
+namespace{
+    const Uint32 known_formats[] = {
+        SDL_PIXELFORMAT_ARGB8888,
+        SDL_PIXELFORMAT_ABGR8888,
+        SDL_PIXELFORMAT_RGBA8888,
+        SDL_PIXELFORMAT_BGRA8888,
+        SDL_PIXELFORMAT_RGB888,
+        SDL_PIXELFORMAT_BGR888,
+        SDL_PIXELFORMAT_RGB565,
+        SDL_PIXELFORMAT_RGB24,
+        SDL_PIXELFORMAT_BGR24
+    };
+
+    Uint32 format_from_name(const std::string& name){
+        std::string full_name = "SDL_PIXELFORMAT_" + name;
+        for(auto format : known_formats){
+            if(full_name == SDL_GetPixelFormatName(format)) return format;
+        }
+        return SDL_PIXELFORMAT_UNKNOWN;
+    }
+
+    std::uint64_t align(std::uint64_t offset){
+        return (offset + archive_alignment - 1) / archive_alignment * archive_alignment;
+    }
+
+    struct packed_image{
+        std::string name;
+        sdl2::Surface_ptr surface;
+    };
+}
+
+int main(int argc, char* argv[]){
+    std::vector<std::string> arguments(argv + 1, argv + argc);
+    Uint32 format = SDL_PIXELFORMAT_UNKNOWN;
+    bool premultiply = false;
+    while(!arguments.empty()){
+        if(arguments[0] == "-f" && arguments.size() >= 2){
+            format = format_from_name(arguments[1]);
+            if(format == SDL_PIXELFORMAT_UNKNOWN){
+                std::cout << "Unknown pixel format " << arguments[1] << std::endl;
+                return 1;
+            }
+            arguments.erase(std::begin(arguments), std::begin(arguments) + 2);
+        }
+        else if(arguments[0] == "-p"){
+            premultiply = true;
+            arguments.erase(std::begin(arguments));
+        }
+        else break;
+    }
+    if(arguments.size() < 2){
+        std::cout << "Usage: asset_packer.out [-f FORMAT] [-p] archive image..." << std::endl;
+        return 1;
+    }
+
+    sdl2::SDL sdl_context(SDL_INIT_VIDEO);
+    sdl2::SDL_Image sdl_image_context;
+    //A hidden window's renderer picks the format with the same rule
+    //asset_manager uses, so archived pixels upload without a conversion
+    if(format == SDL_PIXELFORMAT_UNKNOWN){
+        try{
+            auto window = sdl2::make_window("asset_packer", 0, 0, 1, 1, SDL_WINDOW_HIDDEN);
+            auto renderer = sdl2::make_renderer(window.get(), -1, SDL_RENDERER_ACCELERATED);
+            format = sdl2::native_texture_format(renderer.get());
+        }
+        catch(const std::exception& error){
+            format = sdl2::native_texture_format(nullptr);
+            std::cout << "Warning - no renderer to ask for its format, using "
+                << SDL_GetPixelFormatName(format) << std::endl;
+        }
+    }
+
+    if(premultiply && (!sdl2::premultiply_supported || !SDL_ISPIXELFORMAT_ALPHA(format))){
+        std::cout << "Cannot premultiply " << SDL_GetPixelFormatName(format)
+            << " pixels, it needs SDL 2.0.18 and a format with alpha" << std::endl;
+        return 1;
+    }
+
+    //Decode and convert everything first so the index can be laid out
+    std::vector<packed_image> images;
+    for(auto name = std::begin(arguments) + 1; name != std::end(arguments); ++name){
+        try{
+            auto decoded = sdl2::basic_img_load(name->c_str());
+            images.push_back(packed_image{*name, sdl2::prepare_surface(decoded, format, premultiply)});
+        }
+        catch(const std::exception& error){
+            std::cout << "Error - could not pack " << *name << std::endl << error.what() << std::endl;
+            return 1;
+        }
+    }
+
+    archive_header header;
+    std::memcpy(header.magic, archive_magic, sizeof(header.magic));
+    header.version = archive_version;
+    header.pixel_format = format;
+    header.entry_count = static_cast<std::uint32_t>(images.size());
+    header.flags = premultiply ? archive_premultiplied : 0;
+    header.reserved = 0;
+
+    std::vector<archive_entry> entries(images.size());
+    std::uint64_t offset = sizeof(archive_header) + entries.size() * sizeof(archive_entry);
+    for(std::size_t i = 0; i < images.size(); ++i){
+        entries[i].name_offset = offset;
+        entries[i].name_length = static_cast<std::uint32_t>(images[i].name.size());
+        offset += images[i].name.size();
+    }
+    for(std::size_t i = 0; i < images.size(); ++i){
+        auto& surface = *images[i].surface;
+        entries[i].width = surface.w;
+        entries[i].height = surface.h;
+        //Rows are stored without the surface's padding
+        entries[i].pitch = surface.w * SDL_BYTESPERPIXEL(format);
+        offset = align(offset);
+        entries[i].pixel_offset = offset;
+        offset += static_cast<std::uint64_t>(entries[i].pitch) * surface.h;
+    }
+
+    std::ofstream archive(arguments[0], std::ios::binary | std::ios::trunc);
+    if(!archive){
+        std::cout << "Error - cannot write " << arguments[0] << std::endl;
+        return 1;
+    }
+    archive.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    archive.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(archive_entry));
+    for(auto& image : images) archive.write(image.name.data(), image.name.size());
+
+    const char padding[archive_alignment] = {};
+    for(std::size_t i = 0; i < images.size(); ++i){
+        auto position = static_cast<std::uint64_t>(archive.tellp());
+        archive.write(padding, entries[i].pixel_offset - position);
+
+        auto& surface = *images[i].surface;
+        SDL_LockSurface(&surface);
+        auto row = static_cast<const char*>(surface.pixels);
+        for(int y = 0; y < surface.h; ++y, row += surface.pitch){
+            archive.write(row, entries[i].pitch);
+        }
+        SDL_UnlockSurface(&surface);
+    }
+
+    if(!archive){
+        std::cout << "Error - failed while writing " << arguments[0] << std::endl;
+        return 1;
+    }
+    std::cout << "Packed " << images.size() << " images as "
+        << SDL_GetPixelFormatName(format) << " into " << arguments[0] << std::endl;
+    return 0;
+}
@@ -1,27 +1,68 @@
 #ifndef BASE_SYSTEM_HPP
 #define BASE_SYSTEM_HPP
 
+#include <cstddef>
+#include <cstdint>
+
 #include "component_manager.hpp"
+#include "game_loop.hpp"
 
 class system_interface{
     public:
         virtual void update() = 0;
 };
 
-template <class ComponentPack>
+template <class ComponentPack, class Storage = map_storage>
 class base_system{// : public system_interface{
     protected:
-        component_manager<ComponentPack>& component_pools;
+        component_manager<ComponentPack, Storage>& component_pools;
         bool is_enabled;
+        //Timing of the current frame, null until use_timing is called
+        const frame_timing* timing;
+
+        //Call once per update before reading changes, returns the first
+        //tick this system hasn't seen (0 on the first call). The system
+        //only becomes a change reader on its first call, so systems that
+        //never ask don't hold back the removal logs.
+        std::uint64_t changes_since_last_run(){
+            if(!has_reader){
+                reader = component_pools.add_change_reader(0);
+                has_reader = true;
+            }
+            return component_pools.begin_read(reader);
+        }
+
+    private:
+        std::size_t reader;
+        bool has_reader;
+
     public:
-        base_system(component_manager<ComponentPack>& component_pools):
-            component_pools(component_pools), is_enabled(true)
+        base_system(component_manager<ComponentPack, Storage>& component_pools):
+            component_pools(component_pools), is_enabled(true), timing(nullptr), reader(0), has_reader(false)
         {}
 
+        //Copies would share the change reader, moves take it over
+        base_system(const base_system&) = delete;
+        base_system& operator=(const base_system&) = delete;
+        base_system(base_system&& other) :
+            component_pools(other.component_pools), is_enabled(other.is_enabled), timing(other.timing),
+            reader(other.reader), has_reader(other.has_reader)
+        {
+            other.has_reader = false;
+        }
+
+        //A system that is gone mustn't hold back the removal logs
+        ~base_system(){
+            if(has_reader) component_pools.remove_change_reader(reader);
+        }
+
         void enable(){is_enabled = true;}
         void disable(){is_enabled = false;}
         void toggle_enabled(){is_enabled = !is_enabled;}
 
+        //Usually game_loop::timing(), which stays valid for the whole loop
+        void use_timing(const frame_timing& frame){timing = &frame;}
+
         //virtual void update() = 0;
 };
 
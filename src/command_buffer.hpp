@@ -0,0 +1,238 @@
+//A command buffer records structural changes (creating and destroying
+//entities, adding and removing components) while systems are iterating
+//pools, and applies all of them later at a sync point where nothing is
+//iterating:
+//command_buffer<my_component_manager> commands;
+//auto id = commands.create();
+//commands.add<[component]>(id, [constructor args...]);
+//commands.remove<[component]>(other_id);
+//commands.destroy(another_id);
+//...
+//commands.flush(manager, generator);
+
+//Every thread records into its own buffer. Pool workers (see
+//thread_pool::worker_slot) and the first other thread to record find
+//theirs without a lock after their first use, any further threads take a
+//lock per call. Recording must not overlap with flush().
+
+//create() can't hand out a real handle without touching the shared
+//handle_allocator, so it returns a pending handle that is only meaningful
+//to the buffer of the thread that created it. Pending handles can be used
+//in add/remove/destroy calls made from that same thread and are swapped
+//for real handles during flush().
+
+//flush() applies commands grouped by kind rather than in recording order:
+//creates, then adds, then removes, then destroys. Within each group the
+//commands for a pool are sorted by handle before they are applied. So an
+//add and a remove for the same component in one frame leave the entity
+//without it, and a destroy always wins. Adding a component an entity
+//already has keeps the existing one.
+#ifndef COMMAND_BUFFER_HPP
+#define COMMAND_BUFFER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "game_components.hpp"
+#include "component_manager.hpp"
+#include "thread_pool.hpp"
+
+template <class Manager, class Pack = typename Manager::pack_type>
+class command_buffer;
+
+template <class Manager, template <typename... Args> class t, typename... Components>
+class command_buffer<Manager, t<Components...>>{
+    public:
+        static constexpr std::uint32_t pending_generation = std::numeric_limits<std::uint32_t>::max();
+
+        static bool is_pending(const component_id& id){return id.generation == pending_generation;}
+
+    private:
+        template <class Component>
+        struct add_list{
+            std::vector<std::pair<component_id, Component>> commands;
+        };
+
+        template <class Component>
+        struct remove_list{
+            std::vector<component_id> commands;
+        };
+
+        //Everything one thread has recorded since the last flush
+        struct thread_commands{
+            std::thread::id owner;
+            std::uint32_t pending_count = 0;
+            std::vector<component_id> resolved;
+            std::vector<component_id> destroys;
+            std::tuple<add_list<Components>...> adds;
+            std::tuple<remove_list<Components>...> removes;
+
+            component_id resolve(const component_id& id) const{
+                return is_pending(id) ? resolved[id.index] : id;
+            }
+
+            void clear(){
+                pending_count = 0;
+                resolved.clear();
+                destroys.clear();
+                (void)std::initializer_list<int>{
+                    (std::get<add_list<Components>>(adds).commands.clear(),
+                     std::get<remove_list<Components>>(removes).commands.clear(), 0)...};
+            }
+        };
+
+        std::mutex registration;
+        std::vector<std::unique_ptr<thread_commands>> threads;
+        //Indexed by thread_pool::worker_slot, claimed by the first thread
+        //that records from that slot
+        std::size_t slot_count;
+        std::unique_ptr<std::atomic<thread_commands*>[]> slots;
+
+        //Scratch space reused by every flush
+        std::vector<component_id> merged_ids;
+
+        //The calling thread's buffer, registered on first use
+        thread_commands& local(){
+            auto owner = std::this_thread::get_id();
+            auto slot = thread_pool::worker_slot();
+            if(slot < slot_count){
+                auto commands = slots[slot].load(std::memory_order_acquire);
+                if(commands && commands->owner == owner) return *commands;
+            }
+
+            std::lock_guard<std::mutex> lock(registration);
+            auto found = std::find_if(std::begin(threads), std::end(threads),
+                    [&owner](const std::unique_ptr<thread_commands>& thread){return thread->owner == owner;});
+            if(found != std::end(threads)) return **found;
+
+            threads.push_back(std::make_unique<thread_commands>());
+            auto commands = threads.back().get();
+            commands->owner = owner;
+            if(slot < slot_count && !slots[slot].load(std::memory_order_relaxed)){
+                slots[slot].store(commands, std::memory_order_release);
+            }
+            return *commands;
+        }
+
+        template <class Component>
+        void apply_adds(Manager& manager){
+            std::vector<std::pair<component_id, Component>> merged;
+            for(auto& thread : threads){
+                auto& commands = std::get<add_list<Component>>(thread->adds).commands;
+                for(auto& command : commands){
+                    auto id = thread->resolve(command.first);
+                    command.second.id = id;
+                    merged.emplace_back(id, std::move(command.second));
+                }
+            }
+            if(merged.empty()) return;
+
+            std::stable_sort(std::begin(merged), std::end(merged),
+                    [](const auto& lhs, const auto& rhs){return lhs.first < rhs.first;});
+
+            pool_reserve(manager.template get<Component>(), merged.size());
+            for(auto& command : merged){
+                manager.insert(command.first, std::move(command.second));
+            }
+        }
+
+        template <class Component>
+        void apply_removes(Manager& manager){
+            merged_ids.clear();
+            for(auto& thread : threads){
+                for(auto& id : std::get<remove_list<Component>>(thread->removes).commands){
+                    merged_ids.push_back(thread->resolve(id));
+                }
+            }
+            std::sort(std::begin(merged_ids), std::end(merged_ids));
+
+            for(auto& id : merged_ids){
+                manager.template remove<Component>(id);
+            }
+        }
+
+        void apply_destroys(Manager& manager, id_generator& generator){
+            merged_ids.clear();
+            for(auto& thread : threads){
+                for(auto& id : thread->destroys){
+                    merged_ids.push_back(thread->resolve(id));
+                }
+            }
+            std::sort(std::begin(merged_ids), std::end(merged_ids));
+            merged_ids.erase(
+                    std::unique(std::begin(merged_ids), std::end(merged_ids)),
+                    std::end(merged_ids));
+
+            manager.destroy(std::begin(merged_ids), std::end(merged_ids));
+            for(auto& id : merged_ids){
+                generator.release(id);
+            }
+        }
+
+    public:
+        //thread_slots is how many worker_slot values get a lock free path,
+        //enough for one pool of the default size and the main thread
+        explicit command_buffer(std::size_t thread_slots = thread_pool::default_thread_count() + 1) :
+            registration(), threads(), slot_count(thread_slots),
+            slots(std::make_unique<std::atomic<thread_commands*>[]>(thread_slots)), merged_ids()
+        {
+            for(std::size_t i = 0; i < slot_count; ++i) slots[i].store(nullptr, std::memory_order_relaxed);
+        }
+        command_buffer(const command_buffer&) = delete;
+        command_buffer& operator=(const command_buffer&) = delete;
+
+        //Returns a pending handle, see the note at the top of this file
+        component_id create(){
+            auto& commands = local();
+            return component_id(commands.pending_count++, pending_generation);
+        }
+
+        void destroy(const component_id& id){local().destroys.push_back(id);}
+
+        template <class Component, class... ConstructorArgs>
+        void add(const component_id& id, ConstructorArgs&& ...args){
+            std::get<add_list<Component>>(local().adds).commands.emplace_back(
+                    std::piecewise_construct,
+                    std::forward_as_tuple(id),
+                    std::forward_as_tuple(id, std::forward<ConstructorArgs>(args)...));
+        }
+
+        template <class Component>
+        void remove(const component_id& id){
+            std::get<remove_list<Component>>(local().removes).commands.push_back(id);
+        }
+
+        //Applies and clears every thread's commands. Pending handles are
+        //given real handles from generator in the order they were created.
+        void flush(Manager& manager, id_generator& generator){
+            for(auto& thread : threads){
+                thread->resolved.clear();
+                thread->resolved.reserve(thread->pending_count);
+                generator.allocate(thread->pending_count, std::back_inserter(thread->resolved));
+            }
+
+            (void)std::initializer_list<int>{(apply_adds<Components>(manager), 0)...};
+            (void)std::initializer_list<int>{(apply_removes<Components>(manager), 0)...};
+            apply_destroys(manager, generator);
+
+            for(auto& thread : threads){
+                thread->clear();
+            }
+        }
+};
+
+template <class Manager, template <typename... Args> class t, typename... Components>
+constexpr std::uint32_t command_buffer<Manager, t<Components...>>::pending_generation;
+
+#endif
@@ -8,16 +8,55 @@
 //auto& component_map = new_manager.get<[component]>();
 
 //component_map can then be used as a traditional map with its 
-//key as a uuid (boost generated) and its value as a new instance
-//of the given component.
+//key as an entity_handle (see entity_handle.hpp) and its value as a
+//new instance of the given component.
+
+//The container behind each pool is picked by a storage policy given as
+//the second template parameter. map_storage (the default) keeps every pool
+//as a component_list, sparse_set_storage packs each pool into a contiguous
+//dense array instead:
+//component_manager<component_pack, sparse_set_storage> dense_manager;
+
+//To add components so that the manager can keep track of them
+//new_manager.emplace<[component]>(id, [constructor args...]);
+
+//Every entity has a signature with one bit per component of the pack,
+//membership checks read it instead of searching the pools:
+//new_manager.has<[component]>(id);
+//new_manager.matches<[component1],[component2]>(id);
+
+//To remove one component or every component of an entity
+//new_manager.remove<[component]>(id);
+//new_manager.destroy(id);
+
+//With sparse_set_storage each pool also records when components were
+//added, changed (any mutable access) or removed, see sparse_set.hpp.
+//Whoever reads those changes registers as a change reader and asks for
+//the tick to read from every time:
+//auto reader = new_manager.add_change_reader();
+//...
+//auto since = new_manager.begin_read(reader);
+//new_manager.get<[component]>().each_changed(since, [](component_id id, const [component]& c){...});
+//The tick has to be advanced once per frame (world::track_changes does
+//it), which also drops removals every reader has already seen:
+//new_manager.advance_tick();
+
+//To iterate every entity that has a set of components
+//new_manager.view<[component1],[component2]>().each(
+//    [](component_id id, [component1]& first, [component2]& second){...});
+
+//Both single pools and views can be spread over a thread_pool:
+//new_manager.parallel_for_each<[component]>(workers, [](component_id id, [component]& c){...});
+//new_manager.view<[component1],[component2]>().parallel_each(workers, ...);
 
 //Components must be unique as they can appear in the tuple no more
 //than once, otherwise the program will be ill-formed when trying to 
 //get with a non-existante or duplicated type in the tuple (component manager
-//uses std::get and is also thus not SFINAE-friendly)
+//uses std::get and is also thus not SFINAE-friendly, check has<[component]>()
+//first where that matters)
 
 //From Sam Varshavchik's answer about creating a tuple of 
-//vectors. Used here to create a tuple of component_lists (maps with uuids) 
+//vectors. Used here to create a tuple of component_lists (maps with handles) 
 //where the tuple itself acts as a compile-time registration
 //of each of the pools or maps needed for each component
 //The source can be found as of February 21st, 2017 at this address:
@@ -25,49 +64,58 @@
 #ifndef COMPONENT_MANAGER_HPP
 #define COMPONENT_MANAGER_HPP
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
 #include <map>
 #include <tuple>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "game_components.hpp"
+#include "sparse_set.hpp"
+#include "component_view.hpp"
+#include "component_signature.hpp"
 
 template <typename... Ts>
 struct Typelist{};
 
+//Storage policies, each one names the pool container used for a component
+struct map_storage{
+    template <class Component>
+    using pool = component_list<Component>;
+};
+
+struct sparse_set_storage{
+    template <class Component>
+    using pool = sparse_set<component_id, Component>;
+};
+
 //Declare List
-template <class> class List;
+template <class, class> class List;
 
 //Specialize it, in order to drill down into the template parameters.
-template <template <typename... Args> class t, typename... Ts>
-struct List<t<Ts...>>{
-    using type = std::tuple<component_list<Ts>...>;
+template <template <typename... Args> class t, typename... Ts, class Storage>
+struct List<t<Ts...>, Storage>{
+    using type = std::tuple<typename Storage::template pool<Ts>...>;
 };
 
 template <typename... Ts>
 using component_pack = Typelist<Ts...>;
 
-template <class PackWrapper>
-using manager_map_type = typename List<PackWrapper>::type;
-
-template <class TList>
-struct component_manager{
-    private:
-        manager_map_type<TList> component_maps;
-
-    public:
-        template <class Component>
-        component_list<Component>& get(){
-            return std::get<component_list<Component>>(component_maps);
-        }
-};
+template <class PackWrapper, class Storage = map_storage>
+using manager_map_type = typename List<PackWrapper, Storage>::type;
 
 template <class Key>
 struct map_contains_id{
     public:
         map_contains_id(Key key) : key(key){}
 
-        template <class Value>
-        bool operator()(std::map<Key, Value>& source){
+        template <class Pool>
+        bool operator()(const Pool& source){
             return (source.find(key) != std::end(source));
         }
 
@@ -94,7 +142,237 @@ struct map_emplace_id{
                     std::forward_as_tuple(id),
                     std::forward_as_tuple(id, std::forward<ConstructorArgs>(args)...));
         }
+
+        template <class ComponentType, class... ConstructorArgs>
+        auto operator()(
+                sparse_set<component_id, ComponentType>& target,
+                ConstructorArgs&& ...args){
+            return target.emplace(id, id, std::forward<ConstructorArgs>(args)...);
+        }
 };
 map_emplace_id make_emplace_id(const component_id& id){return map_emplace_id(id);}
 
+//Node based maps don't track changes so they ignore the tick
+template <class ComponentType>
+void pool_set_tick(component_list<ComponentType>&, std::uint64_t){}
+
+template <class ComponentType>
+void pool_set_tick(sparse_set<component_id, ComponentType>& target, std::uint64_t tick){
+    target.set_tick(tick);
+}
+
+template <class ComponentType>
+void pool_log_removals(component_list<ComponentType>&, bool){}
+
+template <class ComponentType>
+void pool_log_removals(sparse_set<component_id, ComponentType>& target, bool enabled){
+    target.log_removals(enabled);
+}
+
+template <class ComponentType>
+void pool_forget_removed_before(component_list<ComponentType>&, std::uint64_t){}
+
+template <class ComponentType>
+void pool_forget_removed_before(sparse_set<component_id, ComponentType>& target, std::uint64_t oldest){
+    target.forget_removed_before(oldest);
+}
+
+//Makes room for count more components ahead of a batch of emplaces.
+//Node based maps can't reserve so for them this does nothing.
+template <class ComponentType>
+void pool_reserve(component_list<ComponentType>&, std::size_t){}
+
+template <class ComponentType>
+void pool_reserve(sparse_set<component_id, ComponentType>& target, std::size_t count){
+    target.reserve(target.size() + count);
+}
+
+//Whether a pool keeps the added/changed/removed stamps of sparse_set
+template <class Pool>
+struct pool_tracks_changes : std::false_type{};
+
+template <class ComponentType>
+struct pool_tracks_changes<sparse_set<component_id, ComponentType>> : std::true_type{};
+
+template <class TList, class Storage = map_storage>
+struct component_manager{
+    public:
+        using pack_type = TList;
+        using storage_type = Storage;
+
+        template <class Component>
+        using pool_type = typename Storage::template pool<Component>;
+
+        static_assert(pack_size<TList>::value <= 64,
+                "Signatures hold one bit per component, at most 64 components per pack");
+
+        //Index of a component in the pack, which is also its signature bit
+        template <class Component>
+        static constexpr std::size_t component_index = pack_index<Component, TList>::value;
+
+        //Whether the pack has a pool for Component, unlike get() this is
+        //safe to use in SFINAE contexts
+        template <class Component>
+        static constexpr bool has(){return pack_contains<Component, TList>::value;}
+
+        template <class... Components>
+        static constexpr component_signature signature_for(){return signature_of<TList, Components...>();}
+
+    private:
+        manager_map_type<TList, Storage> component_maps;
+        signature_table signatures;
+        std::uint64_t tick = 1;
+        //First unread tick of every change reader, free slots hold no_reader
+        std::vector<std::uint64_t> reader_ticks;
+        std::size_t reader_count = 0;
+        static constexpr std::uint64_t no_reader = std::numeric_limits<std::uint64_t>::max();
+
+        template <class Function, std::size_t... I>
+        void for_each_pool(Function& function, std::index_sequence<I...>){
+            (void)std::initializer_list<int>{(function(std::get<I>(component_maps)), 0)...};
+        }
+
+    public:
+        template <class Component>
+        pool_type<Component>& get(){
+            return std::get<pool_type<Component>>(component_maps);
+        }
+
+        //Constructs Component(id, args...) in its pool, does nothing if id
+        //already has one
+        template <class Component, class... ConstructorArgs>
+        auto emplace(const component_id& id, ConstructorArgs&& ...args){
+            auto result = make_emplace_id(id)(get<Component>(), std::forward<ConstructorArgs>(args)...);
+            signatures.set_bits(id, signature_for<Component>());
+            return result;
+        }
+
+        //Moves an already constructed component into its pool
+        template <class Component>
+        bool insert(const component_id& id, Component&& component){
+            auto inserted = get<std::decay_t<Component>>().emplace(id, std::forward<Component>(component)).second;
+            signatures.set_bits(id, signature_for<std::decay_t<Component>>());
+            return inserted;
+        }
+
+        //Removes a single component, its storage stays with the pool for
+        //the next component of that type. Returns false if id didn't have it.
+        template <class Component>
+        bool remove(const component_id& id){
+            signatures.clear_bits(id, signature_for<Component>());
+            return get<Component>().erase(id) > 0;
+        }
+
+        //Removes every component of id and returns how many were removed.
+        //This doesn't release the handle itself, see entity::destroy.
+        std::size_t destroy(const component_id& id){
+            std::size_t removed = 0;
+            for_each_pool([&](auto& pool){removed += pool.erase(id);});
+            signatures.clear(id);
+            return removed;
+        }
+
+        //Same as destroy for a whole range of handles, one pool at a time
+        template <class Iterator>
+        void destroy(Iterator first, Iterator last){
+            for_each_pool([&](auto& pool){
+                for(auto current = first; current != last; ++current) pool.erase(*current);
+            });
+            for(auto current = first; current != last; ++current) signatures.clear(*current);
+        }
+
+        /**********************************************************************/
+        /*                             Membership                             */
+        /**********************************************************************/
+        //These answer from the signature alone without touching any pool.
+        //They stay accurate as long as components are added and removed
+        //through the manager (emplace, insert, remove, destroy) rather than
+        //straight on a pool returned by get().
+
+        component_signature signature(const component_id& id) const{return signatures.get(id);}
+
+        template <class Component>
+        bool has(const component_id& id) const{
+            return signatures.matches(id, signature_for<Component>());
+        }
+
+        template <class... Components>
+        bool matches(const component_id& id) const{
+            return signatures.matches(id, signature_for<Components...>());
+        }
+
+        //Change detection tick shared by every pool (only sparse_set pools
+        //keep stamps). Returns the new tick, changes made from now on are
+        //stamped with it. Removals older than what every change reader
+        //still needs are dropped.
+        std::uint64_t current_tick() const{return tick;}
+        std::uint64_t advance_tick(){
+            ++tick;
+            for_each_pool([this](auto& pool){pool_set_tick(pool, tick);});
+
+            auto oldest = tick;
+            for(auto reader_tick : reader_ticks) oldest = std::min(oldest, reader_tick);
+            for_each_pool([oldest](auto& pool){pool_forget_removed_before(pool, oldest);});
+            return tick;
+        }
+
+        using change_reader = std::size_t;
+
+        //Removals are only logged while at least one reader is registered.
+        //A reader starts out having seen everything before since.
+        change_reader add_change_reader(){return add_change_reader(tick);}
+        change_reader add_change_reader(std::uint64_t since){
+            if(reader_count++ == 0) for_each_pool([](auto& pool){pool_log_removals(pool, true);});
+            auto free_slot = std::find(std::begin(reader_ticks), std::end(reader_ticks), no_reader);
+            if(free_slot != std::end(reader_ticks)){
+                *free_slot = since;
+                return static_cast<change_reader>(free_slot - std::begin(reader_ticks));
+            }
+            reader_ticks.push_back(since);
+            return reader_ticks.size() - 1;
+        }
+
+        void remove_change_reader(change_reader reader){
+            if(reader >= reader_ticks.size() || reader_ticks[reader] == no_reader) return;
+            reader_ticks[reader] = no_reader;
+            if(--reader_count == 0) for_each_pool([](auto& pool){pool_log_removals(pool, false);});
+        }
+
+        //Returns the first tick reader hasn't seen and moves the tick on,
+        //so changes made after this call show up in its next read and the
+        //ones it is about to read don't
+        std::uint64_t begin_read(change_reader reader){
+            auto since = reader_ticks[reader];
+            auto next = advance_tick();
+            reader_ticks[reader] = next;
+            return since;
+        }
+
+        //Calls function(pool) once for every pool, in pack order
+        template <class Function>
+        void for_each_pool(Function function){
+            for_each_pool(function,
+                    std::make_index_sequence<std::tuple_size<manager_map_type<TList, Storage>>::value>{});
+        }
+
+        //Calls function(id, component) for every Component, spread over
+        //workers. See parallel_for_each.hpp.
+        template <class Component, class Function>
+        void parallel_for_each(
+                thread_pool& workers,
+                Function function,
+                parallel_options options = parallel_options()){
+            ::parallel_for_each(workers, get<Component>(), function, options);
+        }
+
+        //See component_view.hpp
+        template <class... Terms>
+        component_view<component_manager, Terms...> view(){
+            return component_view<component_manager, Terms...>(*this);
+        }
+};
+
+template <class TList, class Storage>
+constexpr std::uint64_t component_manager<TList, Storage>::no_reader;
+
 #endif
@@ -0,0 +1,115 @@
+//Compile-time indices of the components in a pack and the per-entity
+//signature built from them. A signature has bit component_index<T> set
+//for every component T the entity currently holds, so checking whether an
+//entity has a whole set of components is a single AND and compare instead
+//of one pool lookup per component.
+#ifndef COMPONENT_SIGNATURE_HPP
+#define COMPONENT_SIGNATURE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "game_components.hpp"
+#include "pack_logic.hpp"
+
+using component_signature = std::uint64_t;
+
+//pack_contains<T, Pack>::value is false rather than an error when T isn't
+//part of the pack, so it can be used for SFINAE
+template <class Component, class Pack>
+struct pack_contains;
+
+template <class Component, template <typename... Args> class t, typename... Ts>
+struct pack_contains<Component, t<Ts...>>{
+    static constexpr bool value = any_of_pack({false, std::is_same<Component, Ts>::value...});
+};
+
+template <class Component, template <typename... Args> class t, typename... Ts>
+constexpr bool pack_contains<Component, t<Ts...>>::value;
+
+//Position of Component in Pack, ill-formed if it isn't in the pack
+template <class Component, class Pack>
+struct pack_index;
+
+template <class Component, template <typename... Args> class t, typename... Ts>
+struct pack_index<Component, t<Component, Ts...>> : std::integral_constant<std::size_t, 0>{};
+
+template <class Component, template <typename... Args> class t, typename First, typename... Ts>
+struct pack_index<Component, t<First, Ts...>> :
+    std::integral_constant<std::size_t, 1 + pack_index<Component, t<Ts...>>::value>{};
+
+template <class Pack>
+struct pack_size;
+
+template <template <typename... Args> class t, typename... Ts>
+struct pack_size<t<Ts...>> : std::integral_constant<std::size_t, sizeof...(Ts)>{};
+
+template <class Component, class Pack>
+constexpr component_signature signature_bit(){
+    return component_signature(1) << pack_index<Component, Pack>::value;
+}
+
+template <class Pack, class... Components>
+constexpr component_signature signature_of(){
+    component_signature bits[] = {0, signature_bit<Components, Pack>()...};
+    component_signature signature = 0;
+    for(auto bit : bits) signature |= bit;
+    return signature;
+}
+
+//Signature of every component in List, which is itself a component_pack
+template <class Pack, class List>
+struct list_signature;
+
+template <class Pack, template <typename... Args> class t, typename... Ts>
+struct list_signature<Pack, t<Ts...>>{
+    static constexpr component_signature value = signature_of<Pack, Ts...>();
+};
+
+template <class Pack, template <typename... Args> class t, typename... Ts>
+constexpr component_signature list_signature<Pack, t<Ts...>>::value;
+
+//Signature per entity handle, stored flat by handle index. An entry
+//written for an older generation of an index reads as empty.
+class signature_table{
+    private:
+        struct entry_type{
+            std::uint32_t generation = 0;
+            component_signature signature = 0;
+        };
+
+        std::vector<entry_type> entries;
+
+        entry_type& entry_of(const component_id& id){
+            if(id.index >= entries.size()) entries.resize(id.index + 1);
+            auto& entry = entries[id.index];
+            if(entry.generation != id.generation){
+                entry.generation = id.generation;
+                entry.signature = 0;
+            }
+            return entry;
+        }
+
+    public:
+        component_signature get(const component_id& id) const{
+            if(id.index >= entries.size()) return 0;
+            auto& entry = entries[id.index];
+            return (entry.generation == id.generation) ? entry.signature : 0;
+        }
+
+        bool matches(const component_id& id, component_signature required) const{
+            return (get(id) & required) == required;
+        }
+
+        void set_bits(const component_id& id, component_signature bits){entry_of(id).signature |= bits;}
+        void clear_bits(const component_id& id, component_signature bits){
+            if(get(id) != 0) entry_of(id).signature &= ~bits;
+        }
+        void clear(const component_id& id){
+            if(get(id) != 0) entry_of(id).signature = 0;
+        }
+};
+
+#endif
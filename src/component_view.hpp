@@ -0,0 +1,280 @@
+//A view joins several pools of a component manager and visits only the
+//entities that hold every required component:
+//auto view = manager.view<render_component, sprite_component>();
+//view.each([](component_id id, render_component& r, sprite_component& s){...});
+
+//Wrapping a component in optional_component makes it optional. It is
+//passed to the callback as a pointer that is null when the entity doesn't
+//have it:
+//manager.view<sprite_component, optional_component<size_component>>()
+//    .each([](component_id id, sprite_component& s, size_component* size){...});
+
+//Terms can be const (view<const [component]>) to read without marking the
+//components as changed in pools that track changes.
+
+//Iteration is driven by the smallest required pool so the number of
+//lookups is bounded by the rarest component. Entities are filtered on the
+//manager's signatures first, so only components that are known to exist
+//are ever looked up. Components must therefore be added through the
+//manager (emplace/insert) to show up in views. Components must not be added
+//to or removed from the viewed pools while a view is being iterated.
+
+//parallel_each(workers, function) splits the driving pool into chunks and
+//runs them on a thread_pool (see parallel_for_each.hpp). Lookups then only
+//go through const pools, so every pool with a mutable term is marked as
+//changed as a whole before the threads start.
+#ifndef COMPONENT_VIEW_HPP
+#define COMPONENT_VIEW_HPP
+
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "game_components.hpp"
+#include "component_signature.hpp"
+#include "pack_logic.hpp"
+#include "parallel_for_each.hpp"
+#include "thread_pool.hpp"
+
+template <class Component>
+struct optional_component{};
+
+//Describes how each requested term of a view is stored and passed on.
+//A const term is looked up through a const pool and passed as const, so
+//it never counts as a change for the pool's change detection.
+template <class Component>
+struct view_term{
+    using component = std::remove_const_t<Component>;
+    using pointer = Component*;
+    static constexpr bool is_optional = false;
+    static constexpr bool is_const = std::is_const<Component>::value;
+
+    static Component& fetch(pointer found){return *found;}
+};
+
+template <class Component>
+struct view_term<optional_component<Component>>{
+    using component = std::remove_const_t<Component>;
+    using pointer = Component*;
+    static constexpr bool is_optional = true;
+    static constexpr bool is_const = std::is_const<Component>::value;
+
+    static pointer fetch(pointer found){return found;}
+};
+
+//Picks the const or mutable overloads of a pool to match a term
+template <bool IsConst>
+struct pool_access{
+    template <class Pool>
+    static Pool& get(Pool& pool){return pool;}
+};
+
+template <>
+struct pool_access<true>{
+    template <class Pool>
+    static const Pool& get(Pool& pool){return pool;}
+};
+
+template <class... Terms>
+constexpr bool has_required_term(){
+    return any_of_pack({false, !view_term<Terms>::is_optional...});
+}
+
+template <class Manager, class... Terms>
+class component_view{
+    private:
+        template <class Term>
+        using component_t = typename view_term<Term>::component;
+
+        static constexpr std::size_t no_driver = std::numeric_limits<std::size_t>::max();
+
+        Manager& manager;
+
+        template <class Term>
+        using pointer_t = typename view_term<Term>::pointer;
+
+        template <class Term>
+        auto& pool_of(){
+            return pool_access<view_term<Term>::is_const>::get(
+                    manager.template get<component_t<Term>>());
+        }
+
+        //The driving pool already holds a pointer to its own component
+        template <class Term, class Driver>
+        pointer_t<Term> lookup(const component_id&, Driver* driver, std::true_type){
+            return driver;
+        }
+
+        template <class Term, class Driver>
+        pointer_t<Term> lookup(const component_id& id, Driver*, std::false_type){
+            auto& pool = pool_of<Term>();
+            auto found = pool.find(id);
+            return (found == std::end(pool)) ? nullptr : &(found->second);
+        }
+
+        template <class Term>
+        std::size_t driving_size(){
+            return view_term<Term>::is_optional ?
+                no_driver : manager.template get<component_t<Term>>().size();
+        }
+
+        template <class Function, std::size_t... I>
+        void visit(
+                Function& function,
+                const component_id& id,
+                std::tuple<pointer_t<Terms>...>& found,
+                std::index_sequence<I...>){
+            bool is_complete = true;
+            (void)std::initializer_list<int>{
+                (is_complete = is_complete &&
+                    (view_term<Terms>::is_optional || std::get<I>(found) != nullptr), 0)...};
+
+            if(is_complete){
+                function(id, view_term<Terms>::fetch(std::get<I>(found))...);
+            }
+        }
+
+        //Signature bits of the required terms
+        static constexpr component_signature required_signature(){
+            component_signature bits[] = {0,
+                (view_term<Terms>::is_optional ? 0 : Manager::template signature_for<component_t<Terms>>())...};
+            component_signature signature = 0;
+            for(auto bit : bits) signature |= bit;
+            return signature;
+        }
+
+        //Optional terms the entity doesn't have are skipped without a lookup
+        template <class Term, class Driver, class IsDriver>
+        pointer_t<Term> lookup(
+                const component_id& id,
+                Driver* driver,
+                IsDriver is_driver,
+                component_signature signature){
+            if((signature & Manager::template signature_for<component_t<Term>>()) == 0) return nullptr;
+            return lookup<Term>(id, driver, is_driver);
+        }
+
+        //Lookups made from worker threads never stamp anything
+        template <class Term, class Driver>
+        pointer_t<Term> shared_lookup(const component_id&, Driver* driver, std::true_type){
+            return driver;
+        }
+
+        template <class Term, class Driver>
+        pointer_t<Term> shared_lookup(const component_id& id, Driver*, std::false_type){
+            const auto& pool = manager.template get<component_t<Term>>();
+            auto found = pool.find(id);
+            return (found == std::end(pool)) ? nullptr : const_cast<pointer_t<Term>>(&(found->second));
+        }
+
+        template <class Term, class Driver, class IsDriver>
+        pointer_t<Term> shared_lookup(
+                const component_id& id,
+                Driver* driver,
+                IsDriver is_driver,
+                component_signature signature){
+            if((signature & Manager::template signature_for<component_t<Term>>()) == 0) return nullptr;
+            return shared_lookup<Term>(id, driver, is_driver);
+        }
+
+        //Mutable iteration marks a change tracking pool as changed as a whole
+        template <class Term>
+        int mark_for_writing(){
+            if(!view_term<Term>::is_const) (void)std::begin(manager.template get<component_t<Term>>());
+            return 0;
+        }
+
+        //Index of the term whose pool is smallest
+        std::size_t pick_driver(){
+            std::size_t sizes[] = {driving_size<Terms>()...};
+            std::size_t driver = 0;
+            for(std::size_t i = 1; i < sizeof...(Terms); ++i){
+                if(sizes[i] < sizes[driver]) driver = i;
+            }
+            return driver;
+        }
+
+        template <class DriverTerm, class Function>
+        void parallel_drive(thread_pool& workers, Function& function, const parallel_options& options){
+            using driver_pointer = pointer_t<DriverTerm>;
+            constexpr auto required = required_signature();
+            const auto& pool = manager.template get<component_t<DriverTerm>>();
+            parallel_for_chunks(workers, pool, [this, &function](std::size_t, auto first, auto last){
+                for(; first != last; ++first){
+                    const component_id id = first->first;
+                    const auto signature = manager.signature(id);
+                    if((signature & required) != required) continue;
+
+                    driver_pointer driver = const_cast<driver_pointer>(&(first->second));
+                    std::tuple<pointer_t<Terms>...> found{
+                        this->template shared_lookup<Terms>(
+                                id, driver, std::is_same<pointer_t<Terms>, driver_pointer>{}, signature)...};
+                    visit(function, id, found, std::index_sequence_for<Terms...>{});
+                }
+            }, options);
+        }
+
+        template <class DriverTerm, class Function>
+        void drive(Function& function){
+            using driver_pointer = pointer_t<DriverTerm>;
+            constexpr auto required = required_signature();
+            for(auto& entry : pool_of<DriverTerm>()){
+                const component_id id = entry.first;
+                const auto signature = manager.signature(id);
+                if((signature & required) != required) continue;
+
+                driver_pointer driver = &(entry.second);
+                std::tuple<pointer_t<Terms>...> found{
+                    lookup<Terms>(id, driver, std::is_same<pointer_t<Terms>, driver_pointer>{}, signature)...};
+                visit(function, id, found, std::index_sequence_for<Terms...>{});
+            }
+        }
+
+    public:
+        static_assert(has_required_term<Terms...>(),
+                "A view needs at least one component that isn't optional");
+
+        component_view(Manager& manager) : manager(manager) {}
+
+        //Calls function(id, components...) for every matching entity
+        template <class Function>
+        void each(Function function){
+            auto driver = pick_driver();
+            std::size_t term = 0;
+            (void)std::initializer_list<int>{
+                ((term++ == driver) ? (drive<Terms>(function), 0) : 0)...};
+        }
+
+        //Same as each() but spread over workers, function is called from
+        //several threads at once
+        template <class Function>
+        void parallel_each(
+                thread_pool& workers,
+                Function function,
+                parallel_options options = parallel_options()){
+            (void)std::initializer_list<int>{mark_for_writing<Terms>()...};
+            auto driver = pick_driver();
+            std::size_t term = 0;
+            (void)std::initializer_list<int>{
+                ((term++ == driver) ? (parallel_drive<Terms>(workers, function, options), 0) : 0)...};
+        }
+
+        //Upper bound on the number of entities each() will visit
+        std::size_t size_hint(){
+            std::size_t sizes[] = {driving_size<Terms>()...};
+            std::size_t smallest = no_driver;
+            for(auto size : sizes){
+                if(size < smallest) smallest = size;
+            }
+            return smallest;
+        }
+};
+
+template <class Manager, class... Terms>
+constexpr std::size_t component_view<Manager, Terms...>::no_driver;
+
+#endif
@@ -8,28 +8,35 @@
 
 #include "game_components.hpp"
 #include "sdl2_ptr.hpp"
+#include "sprite_handle.hpp"
 
 /************************************************/
 /*             Renderable Component             */
 /************************************************/
+//Layers are drawn in increasing order, z orders entities within a layer
 struct render_component : public game_component{
     bool is_visible;
+    int layer;
+    float z;
 
-    render_component(component_id id, bool is_visible=true):
+    render_component(component_id id, bool is_visible=true, int layer=0, float z=0.0f):
         game_component(id),
-        is_visible(is_visible)
+        is_visible(is_visible),
+        layer(layer),
+        z(z)
     {}
 };
 
 /************************************************/
 /*               Sprite Component               */
 /************************************************/
+//The handle comes from asset_manager::register_sprite
 struct sprite_component : public game_component{
-    std::string sprite_name;
+    sprite_handle sprite;
 
-    sprite_component(component_id id, std::string sprite_name):
+    sprite_component(component_id id, sprite_handle sprite):
         game_component(id),
-        sprite_name(sprite_name)
+        sprite(sprite)
     {}
 };
 
@@ -60,4 +67,21 @@ struct position_component : public game_component{
     position_component(component_id id, SDL_Point point)    : position_component(id, point.x, point.y){}
 };
 
+/************************************************/
+/*               Camera Component               */
+/************************************************/
+//What part of the world render_system shows and where on screen it goes.
+//x and y are the world coordinates of the top left of the view, zoom
+//scales world units to pixels and viewport is the rect of the render
+//target to draw into (w or h of 0 means the whole target).
+struct camera_component : public game_component{
+    float x;
+    float y;
+    float zoom;
+    SDL_Rect viewport;
+
+    camera_component(component_id id, float x, float y, float zoom = 1.0f, SDL_Rect viewport = SDL_Rect{0, 0, 0, 0}) :
+        game_component(id), x(x), y(y), zoom(zoom), viewport(viewport) {}
+};
+
 #endif
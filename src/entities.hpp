@@ -1,37 +1,180 @@
 #ifndef ENTITIES_HPP
 #define ENTITIES_HPP
 
+#include <iterator>
 #include <memory>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 #include "game_components.hpp"
 #include "component_manager.hpp"
+#include "components.hpp"
+#include "archetype.hpp"
 
 namespace entity{
     static id_generator generator = id_generator();
 
+    //The component set every image entity is built from
+    using image_components = component_pack<
+        render_component,
+        sprite_component,
+        size_component,
+        position_component
+    >;
+
+    //Everything needed to build one image entity in a batch
+    struct image_descriptor{
+        sprite_handle sprite;
+        int x;
+        int y;
+        int width;
+        int height;
+        bool is_visible;
+        int layer = 0;
+        float z = 0.0f;
+    };
+
     component_id generate_id(){ return generator();}
 
-    template <class ComponentType>
+    std::vector<component_id> generate_ids(std::size_t count){
+        std::vector<component_id> ids;
+        ids.reserve(count);
+        generator.allocate(count, std::back_inserter(ids));
+        return ids;
+    }
+
+    template <class ComponentType, class Storage>
     component_id create_image(
-            component_manager<ComponentType>& manager, 
-            std::string sprite_name, 
-            int x, int y, int width, int height, bool is_visible){
+            component_manager<ComponentType, Storage>& manager, 
+            sprite_handle sprite, 
+            int x, int y, int width, int height, bool is_visible,
+            int layer = 0, float z = 0.0f){
+
+        component_id id = generate_id();
+
+        manager.template emplace<render_component>(id, is_visible, layer, z);
+        manager.template emplace<sprite_component>(id, sprite);
+        manager.template emplace<size_component>(id, width, height);
+        manager.template emplace<position_component>(id, x, y);
+
+        return id;
+    }
+
+    //render_system draws through the first camera it finds
+    template <class ComponentType, class Storage>
+    component_id create_camera(
+            component_manager<ComponentType, Storage>& manager,
+            float x, float y, float zoom = 1.0f,
+            SDL_Rect viewport = SDL_Rect{0, 0, 0, 0}){
 
         component_id id = generate_id();
+        manager.template emplace<camera_component>(id, x, y, zoom, viewport);
+        return id;
+    }
+
+    //Removes every component of id and recycles the handle. Any copy of
+    //id left around is stale afterwards and won't find the components of
+    //whichever entity reuses its slot.
+    template <class ComponentType, class Storage>
+    void destroy(component_manager<ComponentType, Storage>& manager, const component_id& id){
+        manager.destroy(id);
+        generator.release(id);
+    }
+
+    template <class ComponentPack, std::size_t ChunkCapacity>
+    void destroy(archetype<ComponentPack, ChunkCapacity>& entities, const component_id& id){
+        entities.erase(id);
+        generator.release(id);
+    }
+
+    //Builds count image entities at once. Every pool grows a single time
+    //and the handles come out of the generator in one block, they are
+    //returned in the same order as the descriptors.
+    template <class ComponentType, class Storage>
+    std::vector<component_id> create_images(
+            component_manager<ComponentType, Storage>& manager,
+            const image_descriptor* descriptors,
+            std::size_t count){
+
+        auto ids = generate_ids(count);
 
         auto& render_pool = manager.template get<render_component>();
         auto& sprite_pool = manager.template get<sprite_component>();
         auto& size_pool = manager.template get<size_component>();
         auto& position_pool = manager.template get<position_component>();
 
-        auto pool_emplace = make_emplace_id(id);
+        pool_reserve(render_pool, count);
+        pool_reserve(sprite_pool, count);
+        pool_reserve(size_pool, count);
+        pool_reserve(position_pool, count);
+
+        for(std::size_t i = 0; i < count; ++i){
+            auto& descriptor = descriptors[i];
+            auto& id = ids[i];
+
+            manager.template emplace<render_component>(id, descriptor.is_visible, descriptor.layer, descriptor.z);
+            manager.template emplace<sprite_component>(id, descriptor.sprite);
+            manager.template emplace<size_component>(id, descriptor.width, descriptor.height);
+            manager.template emplace<position_component>(id, descriptor.x, descriptor.y);
+        }
+
+        return ids;
+    }
+
+    template <class ComponentType, class Storage>
+    std::vector<component_id> create_images(
+            component_manager<ComponentType, Storage>& manager,
+            const std::vector<image_descriptor>& descriptors){
+        return create_images(manager, descriptors.data(), descriptors.size());
+    }
+
+    template <std::size_t ChunkCapacity>
+    component_id create_image(
+            archetype<image_components, ChunkCapacity>& images,
+            sprite_handle sprite,
+            int x, int y, int width, int height, bool is_visible,
+            int layer = 0, float z = 0.0f){
+
+        component_id id = generate_id();
+
+        images.insert(id,
+                render_component(id, is_visible, layer, z),
+                sprite_component(id, sprite),
+                size_component(id, width, height),
+                position_component(id, x, y));
+
+        return id;
+    }
+
+    template <std::size_t ChunkCapacity>
+    std::vector<component_id> create_images(
+            archetype<image_components, ChunkCapacity>& images,
+            const image_descriptor* descriptors,
+            std::size_t count){
+
+        auto ids = generate_ids(count);
+        images.reserve(images.size() + count);
+
+        for(std::size_t i = 0; i < count; ++i){
+            auto& descriptor = descriptors[i];
+            auto& id = ids[i];
+
+            images.insert(id,
+                    render_component(id, descriptor.is_visible, descriptor.layer, descriptor.z),
+                    sprite_component(id, descriptor.sprite),
+                    size_component(id, descriptor.width, descriptor.height),
+                    position_component(id, descriptor.x, descriptor.y));
+        }
+
+        return ids;
+    }
 
-        pool_emplace(render_pool, is_visible);
-        pool_emplace(sprite_pool, sprite_name);
-        pool_emplace(size_pool, width, height);
-        pool_emplace(position_pool, x, y);
+    template <std::size_t ChunkCapacity>
+    std::vector<component_id> create_images(
+            archetype<image_components, ChunkCapacity>& images,
+            const std::vector<image_descriptor>& descriptors){
+        return create_images(images, descriptors.data(), descriptors.size());
     }
 }
 
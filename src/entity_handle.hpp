@@ -0,0 +1,141 @@
+//Compact entity handles made of a slot index and a generation count. The
+//index is handed out by a handle_allocator from a free list so it stays
+//small and dense, which lets a sparse_set use it directly as an array
+//offset. The generation is bumped every time an index is released, so a
+//handle kept around after its entity was released no longer compares
+//equal to the one that reuses its index and can be detected as stale.
+#ifndef ENTITY_HANDLE_HPP
+#define ENTITY_HANDLE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "sparse_set.hpp"
+
+struct entity_handle{
+    std::uint32_t index;
+    std::uint32_t generation;
+
+    static constexpr std::uint32_t invalid_index = std::numeric_limits<std::uint32_t>::max();
+
+    constexpr entity_handle() : index(invalid_index), generation(0) {}
+    constexpr entity_handle(std::uint32_t index, std::uint32_t generation) :
+        index(index), generation(generation) {}
+
+    constexpr bool is_null() const{return index == invalid_index;}
+};
+
+constexpr std::uint32_t entity_handle::invalid_index;
+
+inline constexpr bool operator==(const entity_handle& lhs, const entity_handle& rhs){
+    return lhs.index == rhs.index && lhs.generation == rhs.generation;
+}
+inline constexpr bool operator!=(const entity_handle& lhs, const entity_handle& rhs){
+    return !(lhs == rhs);
+}
+inline constexpr bool operator<(const entity_handle& lhs, const entity_handle& rhs){
+    return lhs.index < rhs.index || (lhs.index == rhs.index && lhs.generation < rhs.generation);
+}
+
+//Picked up by boost::hash through ADL
+inline std::size_t hash_value(const entity_handle& handle){
+    return (static_cast<std::size_t>(handle.generation) << 32) ^ handle.index;
+}
+
+namespace std{
+    template <>
+    struct hash<entity_handle>{
+        std::size_t operator()(const entity_handle& handle) const{return hash_value(handle);}
+    };
+}
+
+//Handle indices are already dense so the sparse index is a flat array.
+//Each entry remembers the generation it was stored with so stale handles
+//miss instead of finding the component of whoever reused their index.
+template <>
+struct sparse_index<entity_handle>{
+    public:
+        static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+        std::size_t find(const entity_handle& key) const{
+            if(key.index >= entries.size()) return npos;
+            auto& entry = entries[key.index];
+            return (entry.generation == key.generation) ? entry.slot : npos;
+        }
+        void set(const entity_handle& key, std::size_t slot){
+            if(key.index >= entries.size()) entries.resize(key.index + 1);
+            entries[key.index] = entry_type{key.generation, slot};
+        }
+        void erase(const entity_handle& key){
+            if(key.index < entries.size()) entries[key.index].slot = npos;
+        }
+        void reserve(std::size_t count){entries.reserve(count);}
+        void clear(){entries.clear();}
+
+    private:
+        struct entry_type{
+            std::uint32_t generation = 0;
+            std::size_t slot = npos;
+        };
+
+        std::vector<entry_type> entries;
+};
+
+constexpr std::size_t sparse_index<entity_handle>::npos;
+
+//Hands out handles in O(1), recycling released indices before growing
+class handle_allocator{
+    private:
+        std::vector<std::uint32_t> generations;
+        std::vector<std::uint32_t> free_indices;
+
+    public:
+        entity_handle operator()(){
+            if(!free_indices.empty()){
+                auto index = free_indices.back();
+                free_indices.pop_back();
+                return entity_handle(index, generations[index]);
+            }
+            generations.push_back(0);
+            return entity_handle(static_cast<std::uint32_t>(generations.size() - 1), 0);
+        }
+
+        //Writes count fresh handles to out, growing the storage only once
+        template <class OutputIterator>
+        OutputIterator allocate(std::size_t count, OutputIterator out){
+            auto recycled = std::min(count, free_indices.size());
+            for(std::size_t i = 0; i < recycled; ++i){
+                *out++ = (*this)();
+            }
+
+            auto first_new = generations.size();
+            generations.resize(first_new + (count - recycled), 0);
+            for(auto index = first_new; index < generations.size(); ++index){
+                *out++ = entity_handle(static_cast<std::uint32_t>(index), 0);
+            }
+            return out;
+        }
+
+        //Invalidates every copy of handle and makes its index reusable.
+        //Returns false for handles that are already stale.
+        bool release(entity_handle handle){
+            if(!is_alive(handle)) return false;
+            ++generations[handle.index];
+            free_indices.push_back(handle.index);
+            return true;
+        }
+
+        bool is_alive(entity_handle handle) const{
+            return handle.index < generations.size() && generations[handle.index] == handle.generation;
+        }
+
+        void reserve(std::size_t count){generations.reserve(count);}
+
+        std::size_t alive_count() const{return generations.size() - free_indices.size();}
+};
+
+#endif
@@ -0,0 +1,144 @@
+//Collects SDL events and game events during a frame and hands them to
+//subscribers in batches once per frame:
+//event_bus<collision_event, score_event> events;
+//events.subscribe_sdl([](const event_batch<SDL_Event>& batch){...});
+//events.subscribe<collision_event>([&](const event_batch<collision_event>& batch){...});
+
+//Any thread (systems running on the thread pool included) can post game
+//events, posting is lock free and fails when the event type's queue is
+//full:
+//events.post(collision_event{...});
+
+//The main thread then drains SDL and delivers everything, usually at the
+//start of every frame:
+//events.poll_sdl();
+//events.dispatch();
+
+//Queues and batches are sized when the bus is created, after that no event
+//costs a heap allocation. A batch is only valid during the subscriber call.
+#ifndef EVENT_BUS_HPP
+#define EVENT_BUS_HPP
+
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+#include "event_queue.hpp"
+
+//Contiguous run of events
+template <class Event>
+class event_batch{
+    private:
+        const Event* first;
+        std::size_t count;
+
+    public:
+        event_batch(const Event* first, std::size_t count) : first(first), count(count) {}
+
+        const Event* begin() const{return first;}
+        const Event* end() const{return first + count;}
+        std::size_t size() const{return count;}
+        bool empty() const{return count == 0;}
+        const Event& operator[](std::size_t index) const{return first[index];}
+};
+
+template <class... Events>
+class event_bus{
+    private:
+        template <class Event>
+        using subscriber = std::function<void(const event_batch<Event>&)>;
+
+        template <class Event>
+        struct channel{
+            mpsc_queue<Event> queue;
+            std::vector<Event> batch;
+            std::vector<subscriber<Event>> subscribers;
+
+            explicit channel(std::size_t capacity) : queue(capacity), batch(), subscribers() {
+                batch.reserve(queue.capacity());
+            }
+
+            void dispatch(){
+                //Events posted while draining wait for the next dispatch
+                //rather than growing the batch
+                Event event;
+                while(batch.size() < queue.capacity() && queue.try_pop(event)){
+                    batch.push_back(std::move(event));
+                }
+                if(batch.empty()) return;
+
+                event_batch<Event> delivered(batch.data(), batch.size());
+                for(auto& deliver : subscribers) deliver(delivered);
+                batch.clear();
+            }
+        };
+
+        std::tuple<channel<Events>...> channels;
+        ring_buffer<SDL_Event> sdl_events;
+        std::vector<subscriber<SDL_Event>> sdl_subscribers;
+
+        template <class Event>
+        channel<Event>& channel_of(){return std::get<channel<Event>>(channels);}
+
+        template <std::size_t... I>
+        void dispatch_channels(std::index_sequence<I...>){
+            (void)std::initializer_list<int>{(std::get<I>(channels).dispatch(), 0)...};
+        }
+
+    public:
+        //Capacities are per event type, how many events can be posted
+        //between two dispatches and how many SDL events are kept per frame
+        explicit event_bus(std::size_t event_capacity = 1024, std::size_t sdl_capacity = 256) :
+            channels(((void)sizeof(Events), event_capacity)...),
+            sdl_events(sdl_capacity),
+            sdl_subscribers()
+        {}
+
+        event_bus(const event_bus&) = delete;
+        event_bus& operator=(const event_bus&) = delete;
+
+        template <class Event, class Function>
+        void subscribe(Function function){
+            channel_of<Event>().subscribers.emplace_back(std::move(function));
+        }
+
+        template <class Function>
+        void subscribe_sdl(Function function){
+            sdl_subscribers.emplace_back(std::move(function));
+        }
+
+        //Safe from any thread, false if the queue for Event is full
+        template <class Event>
+        bool post(Event event){
+            return channel_of<Event>().queue.try_push(std::move(event));
+        }
+
+        //Main thread only. Whatever doesn't fit in the ring is left in SDL's
+        //own queue for the next frame.
+        void poll_sdl(){
+            SDL_Event* slot;
+            while((slot = sdl_events.next_slot()) != nullptr && SDL_PollEvent(slot) != 0){
+                sdl_events.commit();
+            }
+        }
+
+        //Main thread only, delivers SDL events first, then every game event
+        //type in the order of the pack
+        void dispatch(){
+            if(!sdl_events.empty()){
+                sdl_events.for_each_segment([this](const SDL_Event* first, std::size_t count){
+                    event_batch<SDL_Event> delivered(first, count);
+                    for(auto& deliver : sdl_subscribers) deliver(delivered);
+                });
+                sdl_events.clear();
+            }
+            dispatch_channels(std::index_sequence_for<Events...>{});
+        }
+};
+
+#endif
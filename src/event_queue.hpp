@@ -0,0 +1,151 @@
+//Fixed capacity queues used by event_bus. Both allocate all of their slots
+//up front, pushing and popping never touches the heap.
+
+//ring_buffer is single threaded, push fails once it's full:
+//ring_buffer<SDL_Event> pending(256);
+//pending.push(event);
+//pending.for_each_segment([](const SDL_Event* first, std::size_t count){...});
+//pending.clear();
+
+//mpsc_queue takes pushes from any number of threads at once and pops from
+//a single consumer thread, without locks (bounded queue with per-slot
+//sequence numbers, after Dmitry Vyukov's design):
+//mpsc_queue<my_event> queue(1024);
+//queue.try_push(event);       //any thread
+//while(queue.try_pop(event)){...}  //consumer only
+#ifndef EVENT_QUEUE_HPP
+#define EVENT_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+//Keeps members written by different threads on different cache lines
+constexpr std::size_t cache_line_size = 64;
+
+template <class T>
+class ring_buffer{
+    private:
+        std::unique_ptr<T[]> slots;
+        std::size_t capacity;
+        std::size_t head;
+        std::size_t count;
+
+    public:
+        explicit ring_buffer(std::size_t capacity) :
+            slots(new T[capacity]), capacity(capacity), head(0), count(0)
+        {}
+
+        std::size_t size() const{return count;}
+        bool empty() const{return count == 0;}
+        bool full() const{return count == capacity;}
+
+        bool push(const T& value){
+            if(full()) return false;
+            slots[(head + count) % capacity] = value;
+            ++count;
+            return true;
+        }
+
+        //Slot the next push would write to, for APIs that fill in place
+        //like SDL_PollEvent. commit() makes it part of the buffer.
+        T* next_slot(){return full() ? nullptr : &slots[(head + count) % capacity];}
+        void commit(){++count;}
+
+        bool pop(T& out){
+            if(empty()) return false;
+            out = slots[head];
+            head = (head + 1) % capacity;
+            --count;
+            return true;
+        }
+
+        //Calls function(first, count) for the (at most two) contiguous runs
+        //that make up the buffer, oldest first
+        template <class Function>
+        void for_each_segment(Function function) const{
+            if(empty()) return;
+            auto first_run = (head + count <= capacity) ? count : capacity - head;
+            function(&slots[head], first_run);
+            if(first_run < count) function(&slots[0], count - first_run);
+        }
+
+        void clear(){
+            head = 0;
+            count = 0;
+        }
+};
+
+template <class T>
+class mpsc_queue{
+    private:
+        struct cell{
+            std::atomic<std::size_t> sequence;
+            T value;
+        };
+
+        std::unique_ptr<cell[]> cells;
+        std::size_t mask;
+        char producer_padding[cache_line_size];
+        std::atomic<std::size_t> tail;
+        char consumer_padding[cache_line_size];
+        std::size_t head;
+
+        static std::size_t round_up_power_of_two(std::size_t value){
+            std::size_t power = 2;
+            while(power < value) power <<= 1;
+            return power;
+        }
+
+    public:
+        explicit mpsc_queue(std::size_t capacity) :
+            cells(), mask(round_up_power_of_two(capacity) - 1), tail(0), head(0)
+        {
+            cells.reset(new cell[mask + 1]);
+            for(std::size_t i = 0; i <= mask; ++i){
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        mpsc_queue(const mpsc_queue&) = delete;
+        mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+        std::size_t capacity() const{return mask + 1;}
+
+        //Safe from any thread, false when the queue is full
+        bool try_push(T value){
+            auto position = tail.load(std::memory_order_relaxed);
+            while(true){
+                auto& slot = cells[position & mask];
+                auto sequence = slot.sequence.load(std::memory_order_acquire);
+                auto difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+                if(difference == 0){
+                    if(tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)){
+                        slot.value = std::move(value);
+                        slot.sequence.store(position + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if(difference < 0){
+                    return false;
+                }
+                else{
+                    position = tail.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        //Consumer thread only, false when there is nothing ready
+        bool try_pop(T& out){
+            auto& slot = cells[head & mask];
+            if(slot.sequence.load(std::memory_order_acquire) != head + 1) return false;
+            out = std::move(slot.value);
+            slot.sequence.store(head + mask + 1, std::memory_order_release);
+            ++head;
+            return true;
+        }
+};
+
+#endif
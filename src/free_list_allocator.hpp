@@ -0,0 +1,84 @@
+//Allocator for node based containers that never hands single elements
+//back to the heap while the container is alive. Every freed node goes on a
+//free list and the next insertion reuses it, so a pool that keeps gaining
+//and losing components settles at the size of its busiest moment instead
+//of churning the heap.
+
+//The free list is shared by every copy (and rebind) of an allocator, so it
+//lives exactly as long as the container that owns it. Only single element
+//allocations of the size the list was created for are recycled, anything
+//else goes straight to operator new.
+#ifndef FREE_LIST_ALLOCATOR_HPP
+#define FREE_LIST_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+class free_list{
+    private:
+        std::size_t block_size;
+        std::vector<void*> blocks;
+
+    public:
+        free_list() : block_size(0), blocks() {}
+        free_list(const free_list&) = delete;
+        free_list& operator=(const free_list&) = delete;
+        ~free_list(){
+            for(auto block : blocks) ::operator delete(block);
+        }
+
+        void* allocate(std::size_t size){
+            if(size == block_size && !blocks.empty()){
+                auto block = blocks.back();
+                blocks.pop_back();
+                return block;
+            }
+            if(block_size == 0) block_size = size;
+            return ::operator new(size);
+        }
+
+        void deallocate(void* block, std::size_t size){
+            if(size == block_size) blocks.push_back(block);
+            else ::operator delete(block);
+        }
+
+        std::size_t free_count() const{return blocks.size();}
+};
+
+template <class T>
+class free_list_allocator{
+    private:
+        template <class U>
+        friend class free_list_allocator;
+
+        std::shared_ptr<free_list> list;
+
+    public:
+        using value_type = T;
+
+        free_list_allocator() : list(std::make_shared<free_list>()) {}
+
+        template <class U>
+        free_list_allocator(const free_list_allocator<U>& other) : list(other.list) {}
+
+        T* allocate(std::size_t count){
+            if(count == 1) return static_cast<T*>(list->allocate(sizeof(T)));
+            return static_cast<T*>(::operator new(count * sizeof(T)));
+        }
+
+        void deallocate(T* block, std::size_t count){
+            if(count == 1) list->deallocate(block, sizeof(T));
+            else ::operator delete(block);
+        }
+
+        std::size_t free_count() const{return list->free_count();}
+
+        template <class U>
+        bool operator==(const free_list_allocator<U>& other) const{return list == other.list;}
+        template <class U>
+        bool operator!=(const free_list_allocator<U>& other) const{return list != other.list;}
+};
+
+#endif
@@ -2,15 +2,17 @@
 #define GAME_COMPONENT_HPP
 
 //std lib
+#include <functional>
 #include <iostream>
 #include <map>
+#include <utility>
 
-//boost lib
-#include <boost/uuid/uuid.hpp>
-#include <boost/uuid/uuid_generators.hpp>
+//Local Headers
+#include "entity_handle.hpp"
+#include "free_list_allocator.hpp"
 
-using id_generator = boost::uuids::random_generator;
-using component_id = boost::uuids::uuid;
+using id_generator = handle_allocator;
+using component_id = entity_handle;
 
 struct game_component{
     component_id id;
@@ -18,7 +20,12 @@ struct game_component{
     game_component(component_id id) : id(id) {}
 };
 
+//Nodes of removed components are kept by the pool and reused
 template<class ComponentType>
-using component_list = std::map<component_id, ComponentType>;
+using component_list = std::map<
+    component_id,
+    ComponentType,
+    std::less<component_id>,
+    free_list_allocator<std::pair<const component_id, ComponentType>>>;
 
 #endif
@@ -0,0 +1,147 @@
+//Fixed timestep loop driver. The simulation advances in ticks of a fixed
+//length no matter how fast frames are drawn, rendering happens once per
+//frame and gets the fraction of a tick that has built up since the last
+//one (alpha) to interpolate between the previous and current state:
+//game_loop loop;
+//while(!quit){
+//    [poll events]
+//    loop.frame(
+//        [&](const frame_timing& timing){[advance the simulation one tick]},
+//        [&](const frame_timing& timing){[draw, blending with timing.alpha]});
+//}
+//run() does the same until stop() is called from one of the callbacks.
+
+//If a frame took so long that more than max_ticks_per_frame ticks are due,
+//the rest is dropped (and counted in frame_timing::dropped_seconds) instead
+//of making the next frame even slower, the spiral of death.
+
+//Pacing decides what happens once a frame is done:
+//vsync       nothing, the renderer has to be created with
+//            SDL_RENDERER_PRESENTVSYNC so SDL_RenderPresent does the waiting
+//sleep       sleeps until frame_length after the start of the frame
+//uncapped    nothing, frames run back to back (for benchmarking)
+#ifndef GAME_LOOP_HPP
+#define GAME_LOOP_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+enum class frame_pacing{
+    vsync,
+    sleep,
+    uncapped
+};
+
+struct loop_settings{
+    std::chrono::nanoseconds tick_length = std::chrono::nanoseconds(1000000000 / 60);
+    //Target frame length for frame_pacing::sleep
+    std::chrono::nanoseconds frame_length = std::chrono::nanoseconds(1000000000 / 60);
+    unsigned max_ticks_per_frame = 5;
+    frame_pacing pacing = frame_pacing::sleep;
+};
+
+//Filled in by game_loop every frame, systems can keep a reference to it
+struct frame_timing{
+    std::uint64_t frame = 0;
+    std::uint64_t tick = 0;
+    //Fixed simulation step
+    double tick_seconds = 0;
+    //Wall time from the start of the previous frame to this one
+    double frame_seconds = 0;
+    //Time spent in the callbacks last frame, without waiting for pacing
+    double work_seconds = 0;
+    //Leftover time as a fraction of a tick, in [0, 1)
+    double alpha = 0;
+    unsigned ticks_this_frame = 0;
+    //Simulation time thrown away by the spiral of death clamp this frame
+    double dropped_seconds = 0;
+};
+
+class game_loop{
+    public:
+        using clock = std::chrono::steady_clock;
+
+    private:
+        loop_settings settings;
+        frame_timing stats;
+        clock::time_point last_frame;
+        clock::duration accumulated;
+        bool is_started;
+        bool is_running;
+
+        static double seconds(clock::duration duration){
+            return std::chrono::duration<double>(duration).count();
+        }
+
+        //OS sleeps overshoot, so the last stretch is spent yielding
+        static void wait_until(clock::time_point deadline){
+            constexpr auto spin_margin = std::chrono::milliseconds(1);
+            auto now = clock::now();
+            if(deadline - now > spin_margin) std::this_thread::sleep_until(deadline - spin_margin);
+            while(clock::now() < deadline) std::this_thread::yield();
+        }
+
+    public:
+        explicit game_loop(loop_settings settings = loop_settings()) :
+            settings(settings), stats(), last_frame(), accumulated(0),
+            is_started(false), is_running(true)
+        {
+            stats.tick_seconds = seconds(settings.tick_length);
+        }
+
+        const frame_timing& timing() const{return stats;}
+        const loop_settings& get_settings() const{return settings;}
+
+        bool running() const{return is_running;}
+        void stop(){is_running = false;}
+
+        //Runs simulate(timing) for every tick that is due, then render(timing)
+        //once, then waits according to the pacing
+        template <class Simulate, class Render>
+        void frame(Simulate&& simulate, Render&& render){
+            auto frame_start = clock::now();
+            if(!is_started){
+                last_frame = frame_start;
+                is_started = true;
+            }
+
+            auto elapsed = frame_start - last_frame;
+            last_frame = frame_start;
+            accumulated += elapsed;
+
+            ++stats.frame;
+            stats.frame_seconds = seconds(elapsed);
+            stats.ticks_this_frame = 0;
+            stats.dropped_seconds = 0;
+
+            while(accumulated >= settings.tick_length){
+                if(stats.ticks_this_frame == settings.max_ticks_per_frame){
+                    auto dropped = accumulated - accumulated % settings.tick_length;
+                    stats.dropped_seconds = seconds(dropped);
+                    accumulated -= dropped;
+                    break;
+                }
+                simulate(static_cast<const frame_timing&>(stats));
+                accumulated -= settings.tick_length;
+                ++stats.tick;
+                ++stats.ticks_this_frame;
+            }
+
+            stats.alpha = seconds(accumulated) / stats.tick_seconds;
+            render(static_cast<const frame_timing&>(stats));
+            stats.work_seconds = seconds(clock::now() - frame_start);
+
+            if(settings.pacing == frame_pacing::sleep){
+                wait_until(frame_start + settings.frame_length);
+            }
+        }
+
+        template <class Simulate, class Render>
+        void run(Simulate&& simulate, Render&& render){
+            is_running = true;
+            while(is_running) frame(simulate, render);
+        }
+};
+
+#endif
@@ -16,6 +16,9 @@
 #include "render_system.hpp"
 #include "entities.hpp"
 #include "asset_manager.hpp"
+#include "system_pack.hpp"
+#include "game_loop.hpp"
+#include "event_bus.hpp"
 
 
 //Screen dimensionn constants
@@ -26,7 +29,14 @@ using game_components = component_pack<
     render_component, 
     sprite_component, 
     size_component, 
-    position_component
+    position_component,
+    camera_component
+>;
+using game_component_manager = component_manager<game_components, sparse_set_storage>;
+using game_render_system = render_system<game_components, sparse_set_storage>;
+using game_events = event_bus<>;
+using game_systems = system_pack<
+    game_render_system
 >;
 
 int main(int, char*){
@@ -40,41 +50,71 @@ int main(int, char*){
             SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
             SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
 
+    //Fixed 60Hz simulation, frames paced by the display
+    loop_settings loop_config;
+    loop_config.pacing = frame_pacing::vsync;
+    game_loop loop(loop_config);
+
     //Create Window Texture Renderer
-    sdl2::Renderer_shared renderer = sdl2::make_shared_renderer( main_window.get(), -1, SDL_RENDERER_ACCELERATED);
+    Uint32 renderer_flags = SDL_RENDERER_ACCELERATED;
+    if(loop_config.pacing == frame_pacing::vsync) renderer_flags |= SDL_RENDERER_PRESENTVSYNC;
+    sdl2::Renderer_shared renderer = sdl2::make_shared_renderer( main_window.get(), -1, renderer_flags);
 
     //Define the Component Manager
-    component_manager<game_components> comp_manager;
+    game_component_manager comp_manager;
+
+    //Workers decode assets in the background
+    thread_pool workers;
 
     //Define the Asset Manager
     asset_manager::asset_manager assets(renderer);
+    assets.use_workers(workers);
 
     /***************/
     /*Setup Systems*/
     /***************/
 
+    world<game_components, game_systems> game_world{
+        game_render_system{comp_manager, assets, std::move(main_window), renderer}
+    };
+
     //Initialize the Render System
-    render_system<game_components> render_system{comp_manager, assets, std::move(main_window), renderer};
-    render_system.initialize();
+    game_world.get<game_render_system>().initialize();
+    game_world.for_each_system([&loop](auto& system){system.use_timing(loop.timing());});
+    game_world.track_changes(comp_manager);
 
     //Register media
-    assets.register_sprite("background", "Assets/loaded.png", nullptr, {"background", "level1"}, false);
+    auto background = assets.register_sprite("background", "Assets/loaded.png", nullptr, {"background", "level1"}, false);
 
     //Load media
     assets.load_sprite("background");
 
+    //Camera over the whole window
+    entity::create_camera(comp_manager, 0.0f, 0.0f);
+
     //create_image
-    entity::create_image(comp_manager, "background", 10, 10, SCREEN_WIDTH-20, SCREEN_HEIGHT-20, true);
+    entity::create_image(comp_manager, background, 10, 10, SCREEN_WIDTH-20, SCREEN_HEIGHT-20, true);
 
     bool quit = false;
-    SDL_Event e;
-    while(!quit){
-        while(SDL_PollEvent(&e) != 0){
+    game_events events;
+    events.subscribe_sdl([&quit](const event_batch<SDL_Event>& batch){
+        for(auto& e : batch){
             if(e.type == SDL_QUIT){
                 quit = true;
             }
         }
-        render_system.update();
+    });
+
+    while(!quit){
+        events.poll_sdl();
+        events.dispatch();
+        loop.frame(
+            [](const frame_timing&){
+                //No simulation systems yet
+            },
+            [&game_world](const frame_timing&){
+                game_world.update();
+            });
     }
 
     return 0;
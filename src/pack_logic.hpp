@@ -0,0 +1,24 @@
+//Constexpr folds over a pack expanded into a braced list, for compile-time
+//checks on component and system packs (C++14 has no fold expressions):
+//static_assert(all_of_pack({true, pack_contains<Ts, Pack>::value...}), "...");
+//The leading true/false keeps the list valid when the pack is empty.
+#ifndef PACK_LOGIC_HPP
+#define PACK_LOGIC_HPP
+
+#include <initializer_list>
+
+constexpr bool all_of_pack(std::initializer_list<bool> values){
+    for(auto value : values){
+        if(!value) return false;
+    }
+    return true;
+}
+
+constexpr bool any_of_pack(std::initializer_list<bool> values){
+    for(auto value : values){
+        if(value) return true;
+    }
+    return false;
+}
+
+#endif
@@ -0,0 +1,166 @@
+//Splits a pool (or anything with begin/end) into chunks and spreads them
+//over a thread_pool, the calling thread takes the first chunk itself and
+//helps with the rest while it waits:
+//parallel_for_each(workers, manager.get<[component]>(),
+//    [](component_id id, [component]& c){...});
+
+//Chunks default to roughly cache_chunk_bytes of elements so that each task
+//streams through memory that fits in a core's cache, options.grain_size
+//overrides that with a fixed number of elements per chunk.
+
+//By default the chunk size also takes the number of threads into account
+//to keep every worker busy. With options.deterministic the chunk layout only
+//depends on the number of elements and the grain size, so results that are
+//collected per chunk (parallel_for_chunks passes the chunk index) and then
+//combined in chunk order come out the same on every machine.
+
+//The function is called from several threads at once. It may change the
+//component it is given but must not add or remove components. If it
+//throws, the remaining chunks still run and the first exception is
+//rethrown on the calling thread once every chunk is done.
+#ifndef PARALLEL_FOR_EACH_HPP
+#define PARALLEL_FOR_EACH_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+struct parallel_options{
+    //Elements per chunk, 0 picks one from the element size
+    std::size_t grain_size = 0;
+    bool deterministic = false;
+};
+
+constexpr std::size_t cache_chunk_bytes = 16 * 1024;
+
+template <class Value>
+std::size_t parallel_grain_size(std::size_t count, std::size_t thread_count, const parallel_options& options){
+    if(options.grain_size > 0) return options.grain_size;
+
+    std::size_t by_cache = std::max<std::size_t>(cache_chunk_bytes / sizeof(Value), 1);
+    if(options.deterministic) return by_cache;
+
+    //Several chunks per thread leave room for stealing to even things out
+    std::size_t balanced = std::max<std::size_t>(count / ((thread_count + 1) * 4), 1);
+    return std::min(by_cache, balanced);
+}
+
+namespace parallel_detail{
+    template <class Iterator>
+    void chunk_starts(
+            Iterator first, Iterator last, std::size_t count, std::size_t grain,
+            std::vector<Iterator>& starts, std::random_access_iterator_tag){
+        for(std::size_t offset = 0; offset < count; offset += grain){
+            starts.push_back(first + offset);
+        }
+        starts.push_back(last);
+    }
+
+    //Node based containers have to be walked once to find the boundaries
+    template <class Iterator>
+    void chunk_starts(
+            Iterator first, Iterator last, std::size_t, std::size_t grain,
+            std::vector<Iterator>& starts, std::forward_iterator_tag){
+        std::size_t position = 0;
+        for(auto current = first; current != last; ++current, ++position){
+            if(position % grain == 0) starts.push_back(current);
+        }
+        starts.push_back(last);
+    }
+
+    //Keeps the first exception thrown by any chunk
+    class first_failure{
+        private:
+            std::mutex lock;
+            std::exception_ptr failure;
+
+        public:
+            template <class Function>
+            void run(Function&& function){
+                try{
+                    function();
+                }
+                catch(...){
+                    std::lock_guard<std::mutex> guard(lock);
+                    if(!failure) failure = std::current_exception();
+                }
+            }
+
+            void rethrow(){
+                if(failure) std::rethrow_exception(failure);
+            }
+    };
+}
+
+//Calls function(chunk_index, first, last) for every chunk of [first, last)
+template <class Iterator, class Function>
+void parallel_chunks(
+        thread_pool& workers,
+        Iterator first, Iterator last,
+        std::size_t count, std::size_t grain,
+        Function& function){
+    if(count == 0) return;
+
+    std::vector<Iterator> starts;
+    starts.reserve(count / grain + 2);
+    parallel_detail::chunk_starts(first, last, count, grain, starts,
+            typename std::iterator_traits<Iterator>::iterator_category{});
+
+    //Tasks point at these locals, so nothing leaves this function before
+    //the latch says every submitted task is done
+    auto chunk_count = starts.size() - 1;
+    task_latch latch;
+    parallel_detail::first_failure failure;
+    failure.run([&]{
+        for(std::size_t chunk = 1; chunk < chunk_count; ++chunk){
+            latch.add();
+            try{
+                workers.submit([&, chunk]{
+                    failure.run([&]{function(chunk, starts[chunk], starts[chunk + 1]);});
+                    latch.count_down();
+                });
+            }
+            catch(...){
+                latch.count_down();
+                throw;
+            }
+        }
+        function(0, starts[0], starts[1]);
+    });
+    latch.wait(workers);
+    failure.rethrow();
+}
+
+//Calls function(chunk_index, first, last) with iterators into target
+template <class Pool, class Function>
+void parallel_for_chunks(
+        thread_pool& workers,
+        Pool& target,
+        Function function,
+        parallel_options options = parallel_options()){
+    using value_type = typename std::iterator_traits<decltype(std::begin(target))>::value_type;
+    auto count = target.size();
+    auto grain = parallel_grain_size<value_type>(count, workers.size(), options);
+    parallel_chunks(workers, std::begin(target), std::end(target), count, grain, function);
+}
+
+//Calls function(id, component) for every entry of a component pool
+template <class Pool, class Function>
+void parallel_for_each(
+        thread_pool& workers,
+        Pool& target,
+        Function function,
+        parallel_options options = parallel_options()){
+    parallel_for_chunks(workers, target, [&function](std::size_t, auto first, auto last){
+        for(; first != last; ++first){
+            function(first->first, first->second);
+        }
+    }, options);
+}
+
+#endif
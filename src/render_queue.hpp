@@ -0,0 +1,138 @@
+//Collects the draws of a frame, sorts them back to front by layer then z,
+//and within equal layer/z by texture, then submits them in as few calls as
+//possible:
+//render_queue queue;
+//queue.push(layer, z, texture, clip_rect, dst_rect);
+//...
+//queue.submit(renderer);
+//queue.clear();
+
+//Consecutive draws from the same texture become a single
+//SDL_RenderGeometry call (two triangles per draw) on SDL 2.0.18 and
+//later, older versions fall back to one SDL_RenderCopy per draw. Draws that
+//tie on layer, z and texture keep the order they were pushed in.
+
+//The queue only keeps raw texture pointers, the textures have to stay
+//alive until submit() returns.
+#ifndef RENDER_QUEUE_HPP
+#define RENDER_QUEUE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+class render_queue{
+    private:
+        struct draw_call{
+            std::uint64_t order;
+            SDL_Texture* texture;
+            bool has_clip;
+            SDL_Rect clip;
+            SDL_Rect dst;
+        };
+
+        std::vector<draw_call> draws;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+        std::vector<SDL_Vertex> vertices;
+        std::vector<int> indices;
+#endif
+
+        //Maps a float onto an unsigned int that sorts the same way
+        static std::uint32_t ordered_bits(float value){
+            std::uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+        }
+
+        static std::uint64_t make_order(int layer, float z){
+            auto biased_layer = static_cast<std::uint32_t>(layer) ^ 0x80000000u;
+            return (static_cast<std::uint64_t>(biased_layer) << 32) | ordered_bits(z);
+        }
+
+        bool copy(SDL_Renderer* renderer, const draw_call& draw) const{
+            return SDL_RenderCopy(renderer, draw.texture, draw.has_clip ? &draw.clip : nullptr, &draw.dst) == 0;
+        }
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+        //Draws [first, last), which all share a texture, in one call
+        bool draw_run(SDL_Renderer* renderer, const draw_call* first, const draw_call* last){
+            if(last - first == 1) return copy(renderer, *first);
+
+            int texture_width = 1, texture_height = 1;
+            if(first->texture) SDL_QueryTexture(first->texture, nullptr, nullptr, &texture_width, &texture_height);
+            const float u_scale = 1.0f / texture_width;
+            const float v_scale = 1.0f / texture_height;
+            const SDL_Color white{255, 255, 255, 255};
+
+            vertices.clear();
+            indices.clear();
+            for(auto draw = first; draw != last; ++draw){
+                float u0 = 0.0f, v0 = 0.0f, u1 = 1.0f, v1 = 1.0f;
+                if(draw->has_clip){
+                    u0 = draw->clip.x * u_scale;
+                    v0 = draw->clip.y * v_scale;
+                    u1 = (draw->clip.x + draw->clip.w) * u_scale;
+                    v1 = (draw->clip.y + draw->clip.h) * v_scale;
+                }
+                float x0 = draw->dst.x, y0 = draw->dst.y;
+                float x1 = x0 + draw->dst.w, y1 = y0 + draw->dst.h;
+
+                int base = static_cast<int>(vertices.size());
+                vertices.push_back(SDL_Vertex{SDL_FPoint{x0, y0}, white, SDL_FPoint{u0, v0}});
+                vertices.push_back(SDL_Vertex{SDL_FPoint{x1, y0}, white, SDL_FPoint{u1, v0}});
+                vertices.push_back(SDL_Vertex{SDL_FPoint{x1, y1}, white, SDL_FPoint{u1, v1}});
+                vertices.push_back(SDL_Vertex{SDL_FPoint{x0, y1}, white, SDL_FPoint{u0, v1}});
+                for(int corner : {0, 1, 2, 0, 2, 3}) indices.push_back(base + corner);
+            }
+            return SDL_RenderGeometry(renderer, first->texture,
+                    vertices.data(), static_cast<int>(vertices.size()),
+                    indices.data(), static_cast<int>(indices.size())) == 0;
+        }
+#else
+        bool draw_run(SDL_Renderer* renderer, const draw_call* first, const draw_call* last){
+            bool succeeded = true;
+            for(auto draw = first; draw != last; ++draw) succeeded = copy(renderer, *draw) && succeeded;
+            return succeeded;
+        }
+#endif
+
+    public:
+        std::size_t size() const{return draws.size();}
+        void reserve(std::size_t count){draws.reserve(count);}
+        void clear(){draws.clear();}
+
+        //Lower layers are drawn first, then lower z within a layer. Draws
+        //without a texture are dropped, batched they would reach
+        //SDL_RenderGeometry as untextured white quads.
+        void push(int layer, float z, SDL_Texture* texture, const SDL_Rect* clip, const SDL_Rect& dst){
+            if(!texture) return;
+            draws.push_back(draw_call{make_order(layer, z), texture,
+                    clip != nullptr, clip ? *clip : SDL_Rect{0, 0, 0, 0}, dst});
+        }
+
+        //Sorts and draws everything, returns the number of SDL calls that
+        //failed (see SDL_GetError)
+        std::size_t submit(SDL_Renderer* renderer){
+            std::stable_sort(std::begin(draws), std::end(draws), [](const draw_call& lhs, const draw_call& rhs){
+                if(lhs.order != rhs.order) return lhs.order < rhs.order;
+                return std::less<SDL_Texture*>()(lhs.texture, rhs.texture);
+            });
+
+            std::size_t failures = 0;
+            auto first = draws.data();
+            auto end = draws.data() + draws.size();
+            while(first != end){
+                auto last = first + 1;
+                while(last != end && last->texture == first->texture) ++last;
+                if(!draw_run(renderer, first, last)) ++failures;
+                first = last;
+            }
+            return failures;
+        }
+};
+
+#endif
@@ -2,6 +2,8 @@
 #define RENDER_SYSTEM_HPP
 
 //STL headers
+#include <type_traits>
+#include <vector>
 
 //SDL2 headers
 #include <SDL2/SDL.h>
@@ -11,49 +13,108 @@
 #include "base_system.hpp"
 #include "components.hpp"
 #include "asset_manager.hpp"
+#include "transform_soa.hpp"
+#include "render_queue.hpp"
 
-template <class ComponentPack>
-class render_system : public base_system<ComponentPack>, public system_interface{
+template <class ComponentPack, class Storage = map_storage>
+class render_system : public base_system<ComponentPack, Storage>, public system_interface{
     private:
         sdl2::Window_ptr window;
         sdl2::Renderer_shared renderer;
         asset_manager::asset_manager& assets;
 
+        //Per-frame scratch space, kept between frames so it stops allocating
+        std::vector<asset_manager::sprite_view> frame_sprites;
+        std::vector<bool> frame_has_bounds;
+        rect_arrays frame_bounds;
+        std::vector<SDL_Rect> frame_rects;
+        std::vector<int> frame_layers;
+        std::vector<float> frame_depths;
+        render_queue frame_queue;
+
+        //Camera used for the current frame, falls back to showing the whole
+        //render target 1:1 when the pack has no camera or none exists
+        struct frame_camera{
+            float x;
+            float y;
+            float zoom;
+            SDL_Rect viewport;
+        };
+
+        template <class Camera = camera_component>
+        frame_camera find_camera(std::true_type);
+        frame_camera find_camera(std::false_type);
+
         void draw(sdl2::Texture_ptr texture,
                 SDL_Rect* clip_rect = nullptr,
                 SDL_Rect* dst_rect = nullptr);
     public:
+        //Access declarations used by system_scheduler
+        using reads = std::conditional_t<pack_contains<camera_component, ComponentPack>::value,
+            component_pack<render_component, sprite_component, size_component, position_component, camera_component>,
+            component_pack<render_component, sprite_component, size_component, position_component>>;
+        using writes = component_pack<>;
+        static constexpr bool runs_on_main_thread = true;
+
         void initialize();
         void update();
 
-        render_system(component_manager<ComponentPack>& component_pools, asset_manager::asset_manager& assets) :
+        render_system(component_manager<ComponentPack, Storage>& component_pools, asset_manager::asset_manager& assets) :
             render_system(component_pools, assets,
                     sdl2::make_window(), 
                     sdl2::make_shared_renderer())
         {}
-        render_system(component_manager<ComponentPack>& component_pools, asset_manager::asset_manager& assets,
+        render_system(component_manager<ComponentPack, Storage>& component_pools, asset_manager::asset_manager& assets,
                 sdl2::Window_ptr&& window) :
             render_system(component_pools, assets,
                     std::move(window), 
                     sdl2::make_shared_renderer())
         {}
-        render_system(component_manager<ComponentPack>& component_pools, asset_manager::asset_manager& assets,
+        render_system(component_manager<ComponentPack, Storage>& component_pools, asset_manager::asset_manager& assets,
                 sdl2::Window_ptr&& window, 
                 sdl2::Renderer_shared renderer):
-            ::base_system<ComponentPack>(component_pools), 
+            ::base_system<ComponentPack, Storage>(component_pools), 
             window(std::move(window)), 
             renderer(renderer),
             assets(assets)
         {}
 };
 
-template <class ComponentPack>
-void render_system<ComponentPack>::initialize(){
+template <class ComponentPack, class Storage>
+constexpr bool render_system<ComponentPack, Storage>::runs_on_main_thread;
+
+template <class ComponentPack, class Storage>
+void render_system<ComponentPack, Storage>::initialize(){
     SDL_SetRenderDrawColor(renderer.get(), 0x00, 0x00, 0x00, 0x00);
 }
 
-template <class ComponentPack>
-void render_system<ComponentPack>::update(){
+template <class ComponentPack, class Storage>
+template <class Camera>
+typename render_system<ComponentPack, Storage>::frame_camera
+render_system<ComponentPack, Storage>::find_camera(std::true_type){
+    auto& component_pools = base_system<ComponentPack, Storage>::component_pools;
+    const auto& cameras = component_pools.template get<Camera>();
+    if(cameras.size() == 0) return find_camera(std::false_type{});
+
+    auto& camera = std::begin(cameras)->second;
+    frame_camera frame{camera.x, camera.y, camera.zoom, camera.viewport};
+    if(frame.viewport.w <= 0 || frame.viewport.h <= 0){
+        frame.viewport = find_camera(std::false_type{}).viewport;
+    }
+    if(frame.zoom <= 0.0f) frame.zoom = 1.0f;
+    return frame;
+}
+
+template <class ComponentPack, class Storage>
+typename render_system<ComponentPack, Storage>::frame_camera
+render_system<ComponentPack, Storage>::find_camera(std::false_type){
+    frame_camera frame{0.0f, 0.0f, 1.0f, SDL_Rect{0, 0, 0, 0}};
+    SDL_GetRendererOutputSize(renderer.get(), &frame.viewport.w, &frame.viewport.h);
+    return frame;
+}
+
+template <class ComponentPack, class Storage>
+void render_system<ComponentPack, Storage>::update(){
     if(!this->is_enabled) return;
     if(!window || !renderer){
         std::cout << "Warning - Invalid ";
@@ -63,51 +124,85 @@ void render_system<ComponentPack>::update(){
         std::cout << std::endl;
     }
 
+    //Evict down to the texture budget, then finish whatever the asset
+    //workers decoded since last frame
+    assets.begin_frame();
+    assets.upload_pending();
+
     SDL_RenderClear(renderer.get());
 
-    //auto component_pools = base_system<ComponentPack>::component_pools;
-
-    auto& render_pool = base_system<ComponentPack>::component_pools.template get<render_component>();
-    auto& sprite_pool = base_system<ComponentPack>::component_pools.template get<sprite_component>();
-    auto& size_pool = base_system<ComponentPack>::component_pools.template get<size_component>();
-    auto& position_pool = base_system<ComponentPack>::component_pools.template get<position_component>();
-
-    for(auto& value : render_pool){
-        auto id = value.first;
-        auto& render_component = value.second;
-        auto contains_id = make_contains(id);
-
-        if(render_component.is_visible && contains_id(sprite_pool)){
-            auto& sprite_component = sprite_pool.at(id);
-            auto sprite_asset = assets.get_sprite(sprite_component.sprite_name);
-            //Trying to reliably construct an SDL_Rect* and pass it back
-            std::unique_ptr<SDL_Rect> form_rect = nullptr;
-            auto has_size = contains_id(size_pool);
-            auto has_position = contains_id(position_pool);
-            if(has_size || has_position){
-                float x = 0.0f, y = 0.0f, w = 1.0f, h = 1.0f;
-                if(has_size){
-                    auto& size_component = size_pool.at(id);
-                    w = size_component.width;
-                    h = size_component.height;
-                }
-                if(has_position){
-                    auto& position_component = position_pool.at(id);
-                    x = position_component.x;
-                    y = position_component.y;
-                }
-                form_rect = std::make_unique<SDL_Rect>(SDL_Rect{x,y,w,h});
-            }
-
-            if(SDL_RenderCopy(
-                        renderer.get(), 
-                        sprite_asset.texture.get(), 
-                        sprite_asset.clipping_rect.get(), 
-                        form_rect.get())){
-                std::cout << "Error while rendering texture." << std::endl
-                    << "Error: " << SDL_GetError() << std::endl;
-            }
+    auto& component_pools = base_system<ComponentPack, Storage>::component_pools;
+
+    //Drawing only reads, const terms keep it from marking anything changed
+    auto renderables = component_pools.template view<
+        const render_component,
+        const sprite_component,
+        optional_component<const size_component>,
+        optional_component<const position_component>>();
+
+    auto camera = find_camera(std::integral_constant<bool,
+            pack_contains<camera_component, ComponentPack>::value>{});
+    //Part of the world the viewport shows
+    const float view_left = camera.x;
+    const float view_top = camera.y;
+    const float view_right = camera.x + camera.viewport.w / camera.zoom;
+    const float view_bottom = camera.y + camera.viewport.h / camera.zoom;
+
+    frame_sprites.clear();
+    frame_has_bounds.clear();
+    frame_bounds.clear();
+    frame_layers.clear();
+    frame_depths.clear();
+
+    //Gather everything visible first so the float bounds can be converted
+    //to SDL_Rects in one batch. Anything outside the view is dropped before
+    //its sprite is looked up.
+    renderables.each([&](
+                component_id,
+                const render_component& render,
+                const sprite_component& sprite,
+                const size_component* size,
+                const position_component* position){
+        if(!render.is_visible) return;
+
+        float x = 0.0f, y = 0.0f, w = 1.0f, h = 1.0f;
+        if(size){
+            w = size->width;
+            h = size->height;
         }
+        if(position){
+            x = position->x;
+            y = position->y;
+        }
+        //Entities without bounds fill the whole viewport and are never culled
+        bool has_bounds = size || position;
+        if(has_bounds && (x + w < view_left || x > view_right || y + h < view_top || y > view_bottom)){
+            return;
+        }
+        frame_sprites.push_back(assets.get_sprite(sprite.sprite));
+        frame_has_bounds.push_back(has_bounds);
+        frame_bounds.push_back(x, y, w, h);
+        frame_layers.push_back(render.layer);
+        frame_depths.push_back(render.z);
+    });
+
+    frame_bounds.to_screen(camera.x, camera.y, camera.zoom, camera.viewport.x, camera.viewport.y);
+    frame_bounds.to_rects(frame_rects);
+
+    SDL_RenderSetClipRect(renderer.get(), &camera.viewport);
+
+    //Sorted by layer, z and texture so runs sharing a texture go out in one call
+    frame_queue.clear();
+    for(std::size_t i = 0; i < frame_sprites.size(); ++i){
+        auto& sprite = frame_sprites[i];
+        frame_queue.push(frame_layers[i], frame_depths[i],
+                sprite.texture,
+                sprite.clipping_rect(),
+                frame_has_bounds[i] ? frame_rects[i] : camera.viewport);
+    }
+    if(frame_queue.submit(renderer.get()) > 0){
+        std::cout << "Error while rendering texture." << std::endl
+            << "Error: " << SDL_GetError() << std::endl;
     }
 
     SDL_RenderPresent(renderer.get());
@@ -119,6 +119,21 @@ namespace sdl2{
         return SDL_ConvertSurface(surface, format, flags);
     }
 
+    SDL_Surface* CreateRGBSurfaceWithFormat(Uint32 flags, int w, int h, int depth, Uint32 format){
+        std::cout << "[Surface+]\tCreating " << w << "x" << h << " surface" << std::endl;
+        return SDL_CreateRGBSurfaceWithFormat(flags, w, h, depth, format);
+    }
+
+    SDL_Surface* CreateRGBSurfaceWithFormatFrom(void* pixels, int w, int h, int depth, int pitch, Uint32 format){
+        std::cout << "[Surface+]\tCreating " << w << "x" << h << " surface over existing pixels" << std::endl;
+        return SDL_CreateRGBSurfaceWithFormatFrom(pixels, w, h, depth, pitch, format);
+    }
+
+    SDL_Surface* ConvertSurfaceFormat(SDL_Surface* surface, Uint32 format, Uint32 flags = 0){
+        std::cout << "[Surface+]\tConverting surface to new pixel format" << std::endl;
+        return SDL_ConvertSurfaceFormat(surface, format, flags);
+    }
+
     void FreeSurface(SDL_Surface* surface){
         SDL_FreeSurface(surface);
         std::cout << "[Surface-]\tDestroyed Surface" << std::endl;
@@ -221,6 +236,101 @@ namespace sdl2{
         }
     }
 
+    inline Surface_ptr create_surface(int w, int h, Uint32 format = SDL_PIXELFORMAT_RGBA32){
+        return make_shared_resource(
+#ifdef DEBUG
+                CreateRGBSurfaceWithFormat,
+                FreeSurface,
+#else
+                SDL_CreateRGBSurfaceWithFormat,
+                SDL_FreeSurface,
+#endif
+                SDL_GetError, "Blank Surface", 0, w, h, SDL_BITSPERPIXEL(format), format);
+    }
+
+    //The surface doesn't own pixels, they have to outlive it
+    inline Surface_ptr create_surface_from(void* pixels, int w, int h, int pitch, Uint32 format){
+        return make_shared_resource(
+#ifdef DEBUG
+                CreateRGBSurfaceWithFormatFrom,
+                FreeSurface,
+#else
+                SDL_CreateRGBSurfaceWithFormatFrom,
+                SDL_FreeSurface,
+#endif
+                SDL_GetError, "Borrowed Surface", pixels, w, h, SDL_BITSPERPIXEL(format), pitch, format);
+    }
+
+    inline Surface_ptr convert_surface_format(SDL_Surface* surface, Uint32 format){
+        return make_shared_resource(
+#ifdef DEBUG
+                ConvertSurfaceFormat,
+                FreeSurface,
+#else
+                SDL_ConvertSurfaceFormat,
+                SDL_FreeSurface,
+#endif
+                SDL_GetError, "Converted Surface", surface, format, 0);
+    }
+
+    //First format the renderer takes natively, preferring ones with an alpha
+    //channel. Textures created from surfaces already in it are uploaded
+    //without the driver converting them.
+    inline Uint32 native_texture_format(SDL_Renderer* renderer){
+        SDL_RendererInfo info;
+        if(!renderer || SDL_GetRendererInfo(renderer, &info) != 0) return SDL_PIXELFORMAT_ARGB8888;
+
+        Uint32 without_alpha = SDL_PIXELFORMAT_UNKNOWN;
+        for(Uint32 i = 0; i < info.num_texture_formats; ++i){
+            auto format = info.texture_formats[i];
+            if(SDL_ISPIXELFORMAT_FOURCC(format)) continue;
+            if(SDL_ISPIXELFORMAT_ALPHA(format)) return format;
+            if(without_alpha == SDL_PIXELFORMAT_UNKNOWN) without_alpha = format;
+        }
+        return (without_alpha != SDL_PIXELFORMAT_UNKNOWN) ? without_alpha : SDL_PIXELFORMAT_ARGB8888;
+    }
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    constexpr bool premultiply_supported = true;
+#else
+    constexpr bool premultiply_supported = false;
+#endif
+
+    //Blending for textures whose color is already multiplied by alpha
+    inline SDL_BlendMode premultiplied_blend_mode(){
+        return SDL_ComposeCustomBlendMode(
+                SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+                SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+    }
+
+    //Returns surface itself when it's already in format and nothing has to
+    //change, otherwise a converted copy. Premultiplying converts in the same
+    //pass and is skipped before SDL 2.0.18 or for formats without alpha.
+    inline Surface_ptr prepare_surface(Surface_ptr surface, Uint32 format, bool premultiply = false){
+        premultiply = premultiply && premultiply_supported && SDL_ISPIXELFORMAT_ALPHA(format);
+        if(!premultiply){
+            if(surface->format->format == format) return surface;
+            return convert_surface_format(surface.get(), format);
+        }
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+        auto prepared = create_surface(surface->w, surface->h, format);
+        if(SDL_MUSTLOCK(surface.get())) SDL_LockSurface(surface.get());
+        int result = SDL_PremultiplyAlpha(surface->w, surface->h,
+                surface->format->format, surface->pixels, surface->pitch,
+                format, prepared->pixels, prepared->pitch);
+        if(SDL_MUSTLOCK(surface.get())) SDL_UnlockSurface(surface.get());
+        if(result != 0){
+            std::ostringstream stream("");
+            stream << "Error while premultiplying a surface!" << std::endl << "Error: " << SDL_GetError() << std::endl;
+            throw std::runtime_error(stream.str());
+        }
+        return prepared;
+#else
+        return surface;
+#endif
+    }
+
     inline Renderer_ptr make_renderer(SDL_Window* window, int index, Uint32 flags){
         return make_resource(
 #ifdef DEBUG
@@ -0,0 +1,269 @@
+//A sparse set keeps every value of a pool packed in one contiguous dense
+//array while a sparse index maps each key to the slot it occupies. Lookups
+//go through the index, iteration walks the dense array front to back and
+//removal swaps the last element into the freed slot so the array never has
+//holes in it.
+
+//The interface follows std::map closely enough (find, at, count, begin/end
+//over std::pair<Key, Value>) that code written against a component_list
+//keeps working when a component manager switches storage policies. The
+//order of iteration is insertion order until an erase moves the back
+//element forward. Keys must never be modified through an iterator.
+
+//Each sparse set also keeps track of which values were added, changed or
+//removed and when (see Change Detection below). Only mutable access counts
+//as a change, so read through a const reference whenever possible.
+#ifndef SPARSE_SET_HPP
+#define SPARSE_SET_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+
+//Maps a key to its slot in the dense array. The generic index is a hash
+//map, key types that can be turned straight into an array offset should
+//specialize this with something cheaper.
+template <class Key>
+struct sparse_index{
+    public:
+        static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+        std::size_t find(const Key& key) const{
+            auto slot = slots.find(key);
+            return (slot == std::end(slots)) ? npos : slot->second;
+        }
+        void set(const Key& key, std::size_t slot){slots[key] = slot;}
+        void erase(const Key& key){slots.erase(key);}
+        void reserve(std::size_t count){slots.reserve(count);}
+        void clear(){slots.clear();}
+
+    private:
+        std::unordered_map<Key, std::size_t, boost::hash<Key>> slots;
+};
+
+template <class Key>
+constexpr std::size_t sparse_index<Key>::npos;
+
+template <class Key, class Value>
+class sparse_set{
+    public:
+        using key_type = Key;
+        using mapped_type = Value;
+        using value_type = std::pair<Key, Value>;
+        using size_type = std::size_t;
+        using iterator = typename std::vector<value_type>::iterator;
+        using const_iterator = typename std::vector<value_type>::const_iterator;
+        using tick_type = std::uint64_t;
+
+    private:
+        static constexpr size_type npos = sparse_index<Key>::npos;
+
+        std::vector<value_type> dense;
+        sparse_index<Key> index;
+
+        //Change tracking, the stamps run parallel to dense
+        tick_type tick;
+        tick_type latest_change;
+        tick_type bulk_change;
+        std::vector<tick_type> added_ticks;
+        std::vector<tick_type> changed_ticks;
+        bool logs_removals;
+        std::vector<std::pair<Key, tick_type>> removed;
+
+        void touch(size_type slot){
+            changed_ticks[slot] = tick;
+            latest_change = tick;
+        }
+
+        template <class Function>
+        void each_stamped(const std::vector<tick_type>& stamps, tick_type since, Function& function) const{
+            if(latest_change < since) return;
+            for(size_type slot = 0; slot < dense.size(); ++slot){
+                if(stamps[slot] >= since) function(dense[slot].first, dense[slot].second);
+            }
+        }
+
+    public:
+        sparse_set() :
+            dense(), index(),
+            tick(1), latest_change(0), bulk_change(0),
+            added_ticks(), changed_ticks(), logs_removals(false), removed()
+        {}
+
+        //Mutable iteration can touch anything, so it marks the whole pool
+        //as changed. Iterate through a const reference to only read.
+        iterator begin(){
+            bulk_change = tick;
+            latest_change = tick;
+            return std::begin(dense);
+        }
+        iterator end(){return std::end(dense);}
+        const_iterator begin() const{return std::begin(dense);}
+        const_iterator end() const{return std::end(dense);}
+
+        size_type size() const{return dense.size();}
+        bool empty() const{return dense.empty();}
+
+        void reserve(size_type count){
+            dense.reserve(count);
+            index.reserve(count);
+            added_ticks.reserve(count);
+            changed_ticks.reserve(count);
+        }
+
+        void clear(){
+            if(logs_removals){
+                for(auto& entry : dense) removed.emplace_back(entry.first, tick);
+            }
+            latest_change = tick;
+            dense.clear();
+            index.clear();
+            added_ticks.clear();
+            changed_ticks.clear();
+        }
+
+        //Marks the value of key as changed, same as a mutable find or at
+        iterator find(const Key& key){
+            auto slot = index.find(key);
+            if(slot == npos) return std::end(dense);
+            touch(slot);
+            return std::begin(dense) + slot;
+        }
+
+        const_iterator find(const Key& key) const{
+            auto slot = index.find(key);
+            return (slot == npos) ? end() : begin() + slot;
+        }
+
+        size_type count(const Key& key) const{return (index.find(key) == npos) ? 0 : 1;}
+
+        Value& at(const Key& key){
+            auto slot = index.find(key);
+            if(slot == npos) throw std::out_of_range("sparse_set::at - key not found");
+            touch(slot);
+            return dense[slot].second;
+        }
+
+        const Value& at(const Key& key) const{
+            auto slot = index.find(key);
+            if(slot == npos) throw std::out_of_range("sparse_set::at - key not found");
+            return dense[slot].second;
+        }
+
+        //Constructs the value in place at the back of the dense array. Like
+        //std::map::emplace nothing is constructed if the key already exists.
+        template <class... ConstructorArgs>
+        std::pair<iterator, bool> emplace(const Key& key, ConstructorArgs&& ...args){
+            auto slot = index.find(key);
+            if(slot != npos) return std::make_pair(std::begin(dense) + slot, false);
+
+            dense.emplace_back(std::piecewise_construct,
+                    std::forward_as_tuple(key),
+                    std::forward_as_tuple(std::forward<ConstructorArgs>(args)...));
+            index.set(key, dense.size() - 1);
+            added_ticks.push_back(tick);
+            changed_ticks.push_back(tick);
+            latest_change = tick;
+            return std::make_pair(std::prev(std::end(dense)), true);
+        }
+
+        //Swap-and-pop removal, only the element that was at the back moves
+        size_type erase(const Key& key){
+            auto slot = index.find(key);
+            if(slot == npos) return 0;
+
+            auto last = dense.size() - 1;
+            if(slot != last){
+                dense[slot] = std::move(dense[last]);
+                added_ticks[slot] = added_ticks[last];
+                changed_ticks[slot] = changed_ticks[last];
+                index.set(dense[slot].first, slot);
+            }
+            dense.pop_back();
+            added_ticks.pop_back();
+            changed_ticks.pop_back();
+            index.erase(key);
+            if(logs_removals) removed.emplace_back(key, tick);
+            latest_change = tick;
+            return 1;
+        }
+
+        /**********************************************************************/
+        /*                          Change Detection                          */
+        /**********************************************************************/
+        //Every addition, mutable access and removal is stamped with the
+        //pool's current tick. component_manager::advance_tick moves every
+        //pool forward, queries take the first tick they're interested in.
+
+        tick_type current_tick() const{return tick;}
+        void set_tick(tick_type new_tick){tick = new_tick;}
+
+        void mark_changed(const Key& key){
+            auto slot = index.find(key);
+            if(slot != npos) touch(slot);
+        }
+
+        bool added_since(const Key& key, tick_type since) const{
+            auto slot = index.find(key);
+            return slot != npos && added_ticks[slot] >= since;
+        }
+
+        bool changed_since(const Key& key, tick_type since) const{
+            auto slot = index.find(key);
+            return slot != npos && (changed_ticks[slot] >= since || bulk_change >= since);
+        }
+
+        //Quick test that lets callers skip a pool nobody has touched
+        bool any_changes_since(tick_type since) const{return latest_change >= since;}
+
+        //function(key, value) for values added at or after since
+        template <class Function>
+        void each_added(tick_type since, Function function) const{
+            each_stamped(added_ticks, since, function);
+        }
+
+        //function(key, value) for values added or changed at or after since
+        template <class Function>
+        void each_changed(tick_type since, Function function) const{
+            if(bulk_change >= since){
+                for(auto& entry : dense) function(entry.first, entry.second);
+                return;
+            }
+            each_stamped(changed_ticks, since, function);
+        }
+
+        //Erased keys are only logged while log_removals is on, off by
+        //default so a pool nobody asks about doesn't keep a growing log.
+        //component_manager turns it on while it has change readers.
+        void log_removals(bool enabled){
+            logs_removals = enabled;
+            if(!enabled) removed.clear();
+        }
+        bool is_logging_removals() const{return logs_removals;}
+
+        //function(key) for keys erased at or after since. Removals are kept
+        //until forget_removed_before drops them.
+        template <class Function>
+        void each_removed(tick_type since, Function function) const{
+            for(auto& entry : removed){
+                if(entry.second >= since) function(entry.first);
+            }
+        }
+
+        void forget_removed_before(tick_type oldest){
+            removed.erase(
+                    std::remove_if(std::begin(removed), std::end(removed),
+                        [oldest](const std::pair<Key, tick_type>& entry){return entry.second < oldest;}),
+                    std::end(removed));
+        }
+};
+
+#endif
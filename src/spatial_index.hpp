@@ -0,0 +1,569 @@
+//Spatial index over the position_component/size_component bounds of a
+//component manager's entities. Entities without a size are indexed as
+//points. The structure behind the index is picked by its second template
+//parameter:
+//spatial_index<my_manager, uniform_grid> grid(manager, uniform_grid(64.0f));
+//spatial_index<my_manager, loose_quadtree> tree(manager, loose_quadtree({0, 0, 4096, 4096}, 8));
+
+//uniform_grid buckets entities by fixed size cells, best when entities are
+//about the same size and spread evenly. loose_quadtree keeps every entity
+//in exactly one node sized after the entity, best for mixed sizes or
+//clustered entities. Entities outside a quadtree's world rect still work,
+//they are kept at the root.
+
+//sync() brings the index up to date, usually once per frame before the
+//queries. With sparse_set_storage only entities whose position or size
+//changed (or were removed) since the last sync are touched, otherwise the
+//index is rebuilt:
+//tree.sync();
+//tree.query_rect({x, y, w, h}, [](component_id id){...});
+//tree.query_point(x, y, [](component_id id){...});
+//component_id closest = tree.nearest(x, y);
+
+//Queries are const and don't allocate, they can run from several threads
+//at once as long as nobody syncs at the same time.
+#ifndef SPATIAL_INDEX_HPP
+#define SPATIAL_INDEX_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "components.hpp"
+#include "component_manager.hpp"
+
+struct spatial_rect{
+    float x;
+    float y;
+    float w;
+    float h;
+
+    //Edges count as inside so zero sized points can still be hit
+    bool intersects(const spatial_rect& other) const{
+        return x <= other.x + other.w && other.x <= x + w &&
+            y <= other.y + other.h && other.y <= y + h;
+    }
+
+    bool contains(float point_x, float point_y) const{
+        return point_x >= x && point_x <= x + w && point_y >= y && point_y <= y + h;
+    }
+
+    float distance_squared(float point_x, float point_y) const{
+        float dx = std::max(std::max(x - point_x, 0.0f), point_x - (x + w));
+        float dy = std::max(std::max(y - point_y, 0.0f), point_y - (y + h));
+        return dx * dx + dy * dy;
+    }
+};
+
+struct spatial_item{
+    component_id id;
+    spatial_rect bounds;
+};
+
+//Removes id from items by swapping it with the last one
+inline void erase_spatial_item(std::vector<spatial_item>& items, const component_id& id){
+    for(auto& item : items){
+        if(item.id == id){
+            item = items.back();
+            items.pop_back();
+            return;
+        }
+    }
+}
+
+inline void update_spatial_item(std::vector<spatial_item>& items, const component_id& id, const spatial_rect& bounds){
+    for(auto& item : items){
+        if(item.id == id){
+            item.bounds = bounds;
+            return;
+        }
+    }
+}
+
+/******************************************************************************/
+/*                                Uniform Grid                                */
+/******************************************************************************/
+//Entities are listed in every cell their bounds overlap
+class uniform_grid{
+    private:
+        struct cell_range{
+            int min_x;
+            int min_y;
+            int max_x;
+            int max_y;
+
+            bool operator==(const cell_range& other) const{
+                return min_x == other.min_x && min_y == other.min_y &&
+                    max_x == other.max_x && max_y == other.max_y;
+            }
+        };
+
+        using cell_map = std::unordered_map<std::uint64_t, std::vector<spatial_item>>;
+
+        float cell_size;
+        cell_map cells;
+        std::unordered_map<component_id, cell_range> ranges;
+        //Every cell that was ever occupied lies inside this, bounds nearest()
+        cell_range extents;
+
+        static std::uint64_t cell_key(int x, int y){
+            return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32) |
+                static_cast<std::uint32_t>(y);
+        }
+
+        //Cells past this are clamped, far enough in that ring arithmetic
+        //around any cell stays within int
+        static constexpr int max_cell = 1 << 29;
+
+        //Huge coordinates and NaN would make the cast undefined, they
+        //end up in the outermost cells instead
+        int cell_of(float coordinate) const{
+            float cell = std::floor(coordinate / cell_size);
+            if(!(cell > -max_cell)) return -max_cell;
+            if(cell > max_cell) return max_cell;
+            return static_cast<int>(cell);
+        }
+
+        cell_range range_of(const spatial_rect& bounds) const{
+            return cell_range{cell_of(bounds.x), cell_of(bounds.y),
+                cell_of(bounds.x + bounds.w), cell_of(bounds.y + bounds.h)};
+        }
+
+        const std::vector<spatial_item>* cell_at(int x, int y) const{
+            auto found = cells.find(cell_key(x, y));
+            return (found == std::end(cells)) ? nullptr : &(found->second);
+        }
+
+        //Only cells that exist, so updates and removals don't create any
+        template <class Function>
+        void for_each_cell(const cell_range& range, Function function){
+            for(int y = range.min_y; y <= range.max_y; ++y){
+                for(int x = range.min_x; x <= range.max_x; ++x){
+                    auto found = cells.find(cell_key(x, y));
+                    if(found != std::end(cells)) function(found);
+                }
+            }
+        }
+
+        void add(const cell_range& range, const spatial_item& item){
+            for(int y = range.min_y; y <= range.max_y; ++y){
+                for(int x = range.min_x; x <= range.max_x; ++x){
+                    cells[cell_key(x, y)].push_back(item);
+                }
+            }
+            extents.min_x = std::min(extents.min_x, range.min_x);
+            extents.min_y = std::min(extents.min_y, range.min_y);
+            extents.max_x = std::max(extents.max_x, range.max_x);
+            extents.max_y = std::max(extents.max_y, range.max_y);
+        }
+
+        //Cells left empty are dropped so moving entities don't leave a
+        //trail of them behind
+        void remove(const cell_range& range, const component_id& id){
+            for_each_cell(range, [this, &id](cell_map::iterator cell){
+                erase_spatial_item(cell->second, id);
+                if(cell->second.empty()) cells.erase(cell);
+            });
+        }
+
+        static cell_range empty_extents(){
+            return cell_range{
+                std::numeric_limits<int>::max(), std::numeric_limits<int>::max(),
+                std::numeric_limits<int>::min(), std::numeric_limits<int>::min()};
+        }
+
+    public:
+        explicit uniform_grid(float cell_size = 64.0f) :
+            cell_size(cell_size), cells(), ranges(), extents(empty_extents())
+        {}
+
+        //Inserts id or moves it to its new bounds
+        void set(const component_id& id, const spatial_rect& bounds){
+            auto range = range_of(bounds);
+            auto found = ranges.find(id);
+            if(found == std::end(ranges)){
+                add(range, spatial_item{id, bounds});
+                ranges.emplace(id, range);
+            }
+            else if(found->second == range){
+                for_each_cell(range, [&](cell_map::iterator cell){update_spatial_item(cell->second, id, bounds);});
+            }
+            else{
+                remove(found->second, id);
+                add(range, spatial_item{id, bounds});
+                found->second = range;
+            }
+        }
+
+        void erase(const component_id& id){
+            auto found = ranges.find(id);
+            if(found == std::end(ranges)) return;
+            remove(found->second, id);
+            ranges.erase(found);
+        }
+
+        void clear(){
+            cells.clear();
+            ranges.clear();
+            extents = empty_extents();
+        }
+
+        std::size_t size() const{return ranges.size();}
+
+        //An entity spanning several cells is only reported from the first
+        //cell where it overlaps the area
+        template <class Function>
+        void query_rect(const spatial_rect& area, Function function) const{
+            //Cells outside extents are empty, so a huge area costs no more
+            //than one covering every item
+            auto range = range_of(area);
+            range.min_x = std::max(range.min_x, extents.min_x);
+            range.min_y = std::max(range.min_y, extents.min_y);
+            range.max_x = std::min(range.max_x, extents.max_x);
+            range.max_y = std::min(range.max_y, extents.max_y);
+            for(int y = range.min_y; y <= range.max_y; ++y){
+                for(int x = range.min_x; x <= range.max_x; ++x){
+                    auto cell = cell_at(x, y);
+                    if(!cell) continue;
+                    for(auto& item : *cell){
+                        if(!item.bounds.intersects(area)) continue;
+                        if(x != std::max(cell_of(item.bounds.x), range.min_x)) continue;
+                        if(y != std::max(cell_of(item.bounds.y), range.min_y)) continue;
+                        function(item.id);
+                    }
+                }
+            }
+        }
+
+        template <class Function>
+        void query_point(float x, float y, Function function) const{
+            auto cell = cell_at(cell_of(x), cell_of(y));
+            if(!cell) return;
+            for(auto& item : *cell){
+                if(item.bounds.contains(x, y)) function(item.id);
+            }
+        }
+
+        //Searches rings of cells outwards until no unvisited cell can be
+        //closer than the best match
+        component_id nearest(float x, float y, float max_distance) const{
+            component_id best;
+            float best_distance = max_distance * max_distance;
+            if(ranges.empty()) return best;
+
+            int center_x = cell_of(x);
+            int center_y = cell_of(y);
+            auto visit = [&](int cell_x, int cell_y){
+                auto cell = cell_at(cell_x, cell_y);
+                if(!cell) return;
+                for(auto& item : *cell){
+                    auto distance = item.bounds.distance_squared(x, y);
+                    if(distance <= best_distance){
+                        best_distance = distance;
+                        best = item.id;
+                    }
+                }
+            };
+            //Only the part of a row or column that lies inside extents
+            auto visit_row = [&](int cell_y, int from_x, int to_x){
+                if(cell_y < extents.min_y || cell_y > extents.max_y) return;
+                for(int cell_x = std::max(from_x, extents.min_x); cell_x <= std::min(to_x, extents.max_x); ++cell_x){
+                    visit(cell_x, cell_y);
+                }
+            };
+            auto visit_column = [&](int cell_x, int from_y, int to_y){
+                if(cell_x < extents.min_x || cell_x > extents.max_x) return;
+                for(int cell_y = std::max(from_y, extents.min_y); cell_y <= std::min(to_y, extents.max_y); ++cell_y){
+                    visit(cell_x, cell_y);
+                }
+            };
+
+            //Rings that don't reach extents are empty, so a point far away
+            //starts at the first ring that touches them
+            int first_ring = std::max({0,
+                    extents.min_x - center_x, center_x - extents.max_x,
+                    extents.min_y - center_y, center_y - extents.max_y});
+
+            //The point can sit on the edge of its cell, so cells of ring r
+            //are at least r - 1 cells away
+            for(int ring = first_ring; ; ++ring){
+                float ring_distance = (ring - 1) * cell_size;
+                if(ring > 1 && ring_distance * ring_distance > best_distance) break;
+                if(center_x - ring < extents.min_x && center_x + ring > extents.max_x &&
+                        center_y - ring < extents.min_y && center_y + ring > extents.max_y){
+                    break;
+                }
+
+                visit_row(center_y - ring, center_x - ring, center_x + ring);
+                if(ring > 0){
+                    visit_row(center_y + ring, center_x - ring, center_x + ring);
+                    visit_column(center_x - ring, center_y - ring + 1, center_y + ring - 1);
+                    visit_column(center_x + ring, center_y - ring + 1, center_y + ring - 1);
+                }
+            }
+            return best;
+        }
+};
+
+/******************************************************************************/
+/*                               Loose Quadtree                               */
+/******************************************************************************/
+//Each node's bounds are loosened to twice its cell size, so an entity only
+//has to fit by size and have its center inside a cell to live in that node.
+//Moving an entity rarely changes its node.
+class loose_quadtree{
+    private:
+        static constexpr std::size_t no_child = std::numeric_limits<std::size_t>::max();
+
+        struct node{
+            float center_x;
+            float center_y;
+            float half_size;
+            std::size_t children[4];
+            std::vector<spatial_item> items;
+
+            node(float center_x, float center_y, float half_size) :
+                center_x(center_x), center_y(center_y), half_size(half_size),
+                children{no_child, no_child, no_child, no_child}, items()
+            {}
+
+            spatial_rect loose_bounds() const{
+                return spatial_rect{center_x - 2 * half_size, center_y - 2 * half_size,
+                    4 * half_size, 4 * half_size};
+            }
+        };
+
+        spatial_rect world;
+        std::size_t max_depth;
+        std::vector<node> nodes;
+        std::unordered_map<component_id, std::size_t> locations;
+
+        void reset(){
+            nodes.clear();
+            nodes.emplace_back(world.x + world.w / 2, world.y + world.h / 2, std::max(world.w, world.h) / 2);
+        }
+
+        std::size_t child_of(std::size_t parent, std::size_t quadrant){
+            if(nodes[parent].children[quadrant] == no_child){
+                float quarter = nodes[parent].half_size / 2;
+                float x = nodes[parent].center_x + ((quadrant & 1) ? quarter : -quarter);
+                float y = nodes[parent].center_y + ((quadrant & 2) ? quarter : -quarter);
+                nodes.emplace_back(x, y, quarter);
+                nodes[parent].children[quadrant] = nodes.size() - 1;
+            }
+            return nodes[parent].children[quadrant];
+        }
+
+        //Deepest node whose cell holds the center and is at least as big
+        //as the bounds
+        std::size_t node_for(const spatial_rect& bounds){
+            float extent = std::max(bounds.w, bounds.h);
+            float x = bounds.x + bounds.w / 2;
+            float y = bounds.y + bounds.h / 2;
+            if(!world.contains(x, y)) return 0;
+
+            std::size_t current = 0;
+            for(std::size_t depth = 0; depth < max_depth; ++depth){
+                if(extent > nodes[current].half_size) break;
+                std::size_t quadrant = (x >= nodes[current].center_x ? 1 : 0) |
+                    (y >= nodes[current].center_y ? 2 : 0);
+                current = child_of(current, quadrant);
+            }
+            return current;
+        }
+
+        template <class Function>
+        void query_node(std::size_t index, const spatial_rect& area, Function& function) const{
+            auto& current = nodes[index];
+            if(index != 0 && !current.loose_bounds().intersects(area)) return;
+            for(auto& item : current.items){
+                if(item.bounds.intersects(area)) function(item.id);
+            }
+            for(auto child : current.children){
+                if(child != no_child) query_node(child, area, function);
+            }
+        }
+
+        void nearest_in(std::size_t index, float x, float y, component_id& best, float& best_distance) const{
+            auto& current = nodes[index];
+            if(index != 0 && current.loose_bounds().distance_squared(x, y) > best_distance) return;
+            for(auto& item : current.items){
+                auto distance = item.bounds.distance_squared(x, y);
+                if(distance <= best_distance){
+                    best_distance = distance;
+                    best = item.id;
+                }
+            }
+
+            //Closest children first so the others get pruned more often
+            std::pair<float, std::size_t> order[4];
+            std::size_t count = 0;
+            for(auto child : current.children){
+                if(child == no_child) continue;
+                order[count++] = std::make_pair(nodes[child].loose_bounds().distance_squared(x, y), child);
+            }
+            std::sort(order, order + count);
+            for(std::size_t i = 0; i < count; ++i){
+                nearest_in(order[i].second, x, y, best, best_distance);
+            }
+        }
+
+    public:
+        loose_quadtree(spatial_rect world, std::size_t max_depth = 8) :
+            world(world), max_depth(max_depth), nodes(), locations()
+        {
+            reset();
+        }
+
+        //Inserts id or moves it to its new bounds
+        void set(const component_id& id, const spatial_rect& bounds){
+            auto target = node_for(bounds);
+            auto found = locations.find(id);
+            if(found == std::end(locations)){
+                nodes[target].items.push_back(spatial_item{id, bounds});
+                locations.emplace(id, target);
+            }
+            else if(found->second == target){
+                update_spatial_item(nodes[target].items, id, bounds);
+            }
+            else{
+                erase_spatial_item(nodes[found->second].items, id);
+                nodes[target].items.push_back(spatial_item{id, bounds});
+                found->second = target;
+            }
+        }
+
+        void erase(const component_id& id){
+            auto found = locations.find(id);
+            if(found == std::end(locations)) return;
+            erase_spatial_item(nodes[found->second].items, id);
+            locations.erase(found);
+        }
+
+        void clear(){
+            locations.clear();
+            reset();
+        }
+
+        std::size_t size() const{return locations.size();}
+
+        template <class Function>
+        void query_rect(const spatial_rect& area, Function function) const{
+            query_node(0, area, function);
+        }
+
+        template <class Function>
+        void query_point(float x, float y, Function function) const{
+            query_node(0, spatial_rect{x, y, 0, 0}, function);
+        }
+
+        component_id nearest(float x, float y, float max_distance) const{
+            component_id best;
+            float best_distance = max_distance * max_distance;
+            nearest_in(0, x, y, best, best_distance);
+            return best;
+        }
+};
+
+constexpr int uniform_grid::max_cell;
+constexpr std::size_t loose_quadtree::no_child;
+
+/******************************************************************************/
+/*                               Spatial Index                                */
+/******************************************************************************/
+template <class Manager, class Structure = uniform_grid>
+class spatial_index{
+    private:
+        Manager& manager;
+        Structure structure;
+        //Registered for the index's whole life so removals are logged
+        //between syncs
+        typename Manager::change_reader reader;
+        std::vector<component_id> dirty;
+
+        spatial_rect bounds_of(const component_id& id, const position_component& position){
+            const auto& sizes = manager.template get<size_component>();
+            auto size = sizes.find(id);
+            if(size == std::end(sizes)) return spatial_rect{position.x, position.y, 0, 0};
+            return spatial_rect{position.x, position.y, size->second.width, size->second.height};
+        }
+
+        void refresh(const component_id& id){
+            const auto& positions = manager.template get<position_component>();
+            auto position = positions.find(id);
+            if(position == std::end(positions)) structure.erase(id);
+            else structure.set(id, bounds_of(id, position->second));
+        }
+
+        //Only what changed since the last sync
+        void sync(std::true_type){
+            const auto& positions = manager.template get<position_component>();
+            const auto& sizes = manager.template get<size_component>();
+            auto changed = [this](const component_id& id, const auto&){dirty.push_back(id);};
+            auto removed = [this](const component_id& id){dirty.push_back(id);};
+
+            auto since = manager.begin_read(reader);
+            dirty.clear();
+            positions.each_changed(since, changed);
+            sizes.each_changed(since, changed);
+            positions.each_removed(since, removed);
+            sizes.each_removed(since, removed);
+            for(auto& id : dirty) refresh(id);
+        }
+
+        //Pools that don't track changes can't say what moved
+        void sync(std::false_type){rebuild();}
+
+    public:
+        spatial_index(Manager& manager, Structure structure = Structure()) :
+            manager(manager), structure(std::move(structure)),
+            reader(manager.add_change_reader(0)), dirty()
+        {}
+
+        spatial_index(const spatial_index&) = delete;
+        spatial_index& operator=(const spatial_index&) = delete;
+
+        ~spatial_index(){
+            manager.remove_change_reader(reader);
+        }
+
+        void sync(){
+            sync(pool_tracks_changes<typename Manager::template pool_type<position_component>>{});
+        }
+
+        void rebuild(){
+            manager.begin_read(reader);
+            structure.clear();
+            const auto& positions = manager.template get<position_component>();
+            for(auto& entry : positions) structure.set(entry.first, bounds_of(entry.first, entry.second));
+        }
+
+        std::size_t size() const{return structure.size();}
+
+        //function(id) for every entity whose bounds overlap area
+        template <class Function>
+        void query_rect(const spatial_rect& area, Function function) const{
+            structure.query_rect(area, function);
+        }
+
+        //function(id) for every entity whose bounds contain the point
+        template <class Function>
+        void query_point(float x, float y, Function function) const{
+            structure.query_point(x, y, function);
+        }
+
+        //Entity whose bounds are closest to the point, a null handle if
+        //there is none within max_distance
+        component_id nearest(float x, float y,
+                float max_distance = std::numeric_limits<float>::max()) const{
+            return structure.nearest(x, y, max_distance);
+        }
+};
+
+#endif
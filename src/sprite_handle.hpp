@@ -0,0 +1,33 @@
+//Interned sprite name handed out by asset_manager::register_sprite. It is
+//the sprite's slot in the manager's sprite table, so components can store
+//it instead of the name and drawing resolves it without touching strings:
+//auto player = assets.register_sprite("player", "Assets/player.png");
+//entity::create_image(manager, player, x, y, w, h, true);
+//A default constructed handle refers to no sprite.
+#ifndef SPRITE_HANDLE_HPP
+#define SPRITE_HANDLE_HPP
+
+#include <cstdint>
+#include <limits>
+
+struct sprite_handle{
+    std::uint32_t index;
+
+    static constexpr std::uint32_t invalid_index = std::numeric_limits<std::uint32_t>::max();
+
+    constexpr sprite_handle() : index(invalid_index) {}
+    constexpr explicit sprite_handle(std::uint32_t index) : index(index) {}
+
+    constexpr bool is_null() const{return index == invalid_index;}
+};
+
+constexpr std::uint32_t sprite_handle::invalid_index;
+
+inline constexpr bool operator==(const sprite_handle& lhs, const sprite_handle& rhs){
+    return lhs.index == rhs.index;
+}
+inline constexpr bool operator!=(const sprite_handle& lhs, const sprite_handle& rhs){
+    return !(lhs == rhs);
+}
+
+#endif
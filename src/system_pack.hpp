@@ -0,0 +1,135 @@
+//To create a pack of systems, mirrors component_pack:
+//using my_system_pack = system_pack<[system1],[system2],[...]>;
+
+//A world owns one instance of every system in the pack and updates them
+//in pack order. Calls are made on the concrete types, so there is no
+//virtual dispatch and small systems can be inlined into the loop:
+//world<my_component_pack, my_system_pack> game_world{[system1](...), [system2](...)};
+//game_world.get<[system1]>().initialize();
+//...
+//game_world.update();
+
+//To move the change tick of a component_manager once per frame, after
+//every system has run:
+//game_world.track_changes(manager);
+
+//Systems that declare reads/writes (see system_scheduler.hpp) are checked
+//at compile time against the component pack of the world. Systems that
+//don't declare them aren't checked.
+
+//The same systems can still be handed to a system_scheduler to run them
+//in parallel instead:
+//game_world.add_to(scheduler);
+#ifndef SYSTEM_PACK_HPP
+#define SYSTEM_PACK_HPP
+
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "component_signature.hpp"
+#include "pack_logic.hpp"
+#include "system_scheduler.hpp"
+
+template <class... Systems>
+struct system_pack{};
+
+//Whether every component of List is part of Pack
+template <class Pack, class List>
+struct pack_includes;
+
+template <class Pack, template <typename... Args> class t, typename... Ts>
+struct pack_includes<Pack, t<Ts...>>{
+    static constexpr bool value = all_of_pack({true, pack_contains<Ts, Pack>::value...});
+};
+
+template <class Pack, template <typename... Args> class t, typename... Ts>
+constexpr bool pack_includes<Pack, t<Ts...>>::value;
+
+//Undeclared accesses count as valid
+template <class Pack, class System, class = void>
+struct system_reads_valid : std::true_type{};
+
+template <class Pack, class System>
+struct system_reads_valid<Pack, System, std::conditional_t<false, typename System::reads, void>> :
+    std::integral_constant<bool, pack_includes<Pack, typename System::reads>::value>{};
+
+template <class Pack, class System, class = void>
+struct system_writes_valid : std::true_type{};
+
+template <class Pack, class System>
+struct system_writes_valid<Pack, System, std::conditional_t<false, typename System::writes, void>> :
+    std::integral_constant<bool, pack_includes<Pack, typename System::writes>::value>{};
+
+template <class ComponentPack, class SystemPack>
+class world;
+
+template <class ComponentPack, class... Systems>
+class world<ComponentPack, system_pack<Systems...>>{
+    private:
+        std::tuple<Systems...> systems;
+        //Empty until track_changes is called
+        std::function<void()> advance_tick;
+
+        //Qualified calls skip the vtable even when update() is virtual
+        template <std::size_t... I>
+        void update(std::index_sequence<I...>){
+            (void)std::initializer_list<int>{
+                (std::get<I>(systems).Systems::update(), 0)...};
+        }
+
+        template <class Function, std::size_t... I>
+        void for_each_system(Function& function, std::index_sequence<I...>){
+            (void)std::initializer_list<int>{(function(std::get<I>(systems)), 0)...};
+        }
+
+    public:
+        using component_pack_type = ComponentPack;
+        using system_pack_type = system_pack<Systems...>;
+
+        //Takes one (usually temporary) system per type in the pack
+        template <class... Args>
+        explicit world(Args&& ...args) : systems(std::forward<Args>(args)...) {
+            static_assert(all_of_pack({true, system_reads_valid<ComponentPack, Systems>::value...}),
+                    "A system reads a component that isn't in the world's component pack");
+            static_assert(all_of_pack({true, system_writes_valid<ComponentPack, Systems>::value...}),
+                    "A system writes a component that isn't in the world's component pack");
+        }
+
+        world(const world&) = delete;
+        world& operator=(const world&) = delete;
+
+        template <class System>
+        System& get(){return std::get<System>(systems);}
+
+        //Updates every system once, in pack order
+        void update(){
+            update(std::index_sequence_for<Systems...>{});
+            if(advance_tick) advance_tick();
+        }
+
+        //Advances manager's tick at the end of every update so changes
+        //made next frame are told apart from this one's. The manager has
+        //to outlive the world.
+        template <class Manager>
+        void track_changes(Manager& manager){
+            advance_tick = [&manager]{manager.advance_tick();};
+        }
+
+        //Calls function(system) once for every system, in pack order
+        template <class Function>
+        void for_each_system(Function function){
+            for_each_system(function, std::index_sequence_for<Systems...>{});
+        }
+
+        //Registers every system with a scheduler, which then owns when
+        //they run. The world has to outlive the scheduler.
+        void add_to(system_scheduler<ComponentPack>& scheduler){
+            for_each_system([&scheduler](auto& system){scheduler.add(system);});
+        }
+};
+
+#endif
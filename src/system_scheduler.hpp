@@ -0,0 +1,212 @@
+//Runs a frame's worth of systems, in parallel wherever their component
+//accesses allow it. Every system declares which components it reads and
+//which it writes:
+//class movement_system : public base_system<...>, public system_interface{
+//    public:
+//        using reads = component_pack<velocity_component>;
+//        using writes = component_pack<position_component>;
+//        void update();
+//};
+//Systems that talk to SDL (rendering, input, ...) have to stay on the
+//thread that created the window, they say so with
+//        static constexpr bool runs_on_main_thread = true;
+//A system that doesn't declare reads/writes is assumed to read and write
+//everything, so it never overlaps with anything.
+
+//Two systems conflict when one writes a component the other reads or
+//writes. Conflicting systems run in the order they were added, everything
+//else may run at the same time on the thread pool:
+//system_scheduler<my_component_pack> scheduler(pool);
+//scheduler.add(movement);
+//scheduler.add(render);
+//...
+//scheduler.run_frame();
+//run_frame() has to be called from the main thread and returns once every
+//system has finished.
+#ifndef SYSTEM_SCHEDULER_HPP
+#define SYSTEM_SCHEDULER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "component_signature.hpp"
+#include "thread_pool.hpp"
+
+//Reads the declarations described above off a system type
+template <class System, class = void>
+struct system_reads{
+    template <class Pack>
+    static constexpr component_signature signature(){return ~component_signature(0);}
+};
+
+template <class System>
+struct system_reads<System, std::conditional_t<false, typename System::reads, void>>{
+    template <class Pack>
+    static constexpr component_signature signature(){
+        return list_signature<Pack, typename System::reads>::value;
+    }
+};
+
+template <class System, class = void>
+struct system_writes{
+    template <class Pack>
+    static constexpr component_signature signature(){return ~component_signature(0);}
+};
+
+template <class System>
+struct system_writes<System, std::conditional_t<false, typename System::writes, void>>{
+    template <class Pack>
+    static constexpr component_signature signature(){
+        return list_signature<Pack, typename System::writes>::value;
+    }
+};
+
+template <class System, class = void>
+struct system_pinned : std::false_type{};
+
+template <class System>
+struct system_pinned<System, std::conditional_t<false, decltype(System::runs_on_main_thread), void>> :
+    std::integral_constant<bool, System::runs_on_main_thread>{};
+
+template <class ComponentPack>
+class system_scheduler{
+    private:
+        struct scheduled_system{
+            std::function<void()> update;
+            component_signature reads;
+            component_signature writes;
+            bool pinned;
+            std::vector<std::size_t> dependents;
+            std::size_t dependency_count;
+        };
+
+        thread_pool& pool;
+        std::vector<scheduled_system> systems;
+        bool graph_is_stale;
+
+        //Per frame state
+        std::unique_ptr<std::atomic<std::size_t>[]> waiting_on;
+        std::atomic<std::size_t> unfinished;
+        std::mutex main_lock;
+        std::condition_variable main_wake;
+        std::deque<std::size_t> main_ready;
+
+        static bool conflicts(const scheduled_system& first, const scheduled_system& second){
+            return (first.writes & (second.reads | second.writes)) != 0 ||
+                (second.writes & first.reads) != 0;
+        }
+
+        //Each system depends on every earlier system it conflicts with
+        void build_graph(){
+            for(auto& system : systems){
+                system.dependents.clear();
+                system.dependency_count = 0;
+            }
+            for(std::size_t later = 0; later < systems.size(); ++later){
+                for(std::size_t earlier = 0; earlier < later; ++earlier){
+                    if(conflicts(systems[earlier], systems[later])){
+                        systems[earlier].dependents.push_back(later);
+                        ++systems[later].dependency_count;
+                    }
+                }
+            }
+            waiting_on.reset(new std::atomic<std::size_t>[systems.size()]);
+            graph_is_stale = false;
+        }
+
+        void schedule(std::size_t index){
+            if(systems[index].pinned){
+                {
+                    std::lock_guard<std::mutex> lock(main_lock);
+                    main_ready.push_back(index);
+                }
+                main_wake.notify_one();
+            }
+            else{
+                pool.submit([this, index]{run(index);});
+            }
+        }
+
+        void run(std::size_t index){
+            systems[index].update();
+            for(auto dependent : systems[index].dependents){
+                if(--waiting_on[dependent] == 0) schedule(dependent);
+            }
+            if(--unfinished == 0){
+                std::lock_guard<std::mutex> lock(main_lock);
+                main_wake.notify_one();
+            }
+        }
+
+        bool pop_main_ready(std::size_t& index){
+            std::lock_guard<std::mutex> lock(main_lock);
+            if(main_ready.empty()) return false;
+            index = main_ready.front();
+            main_ready.pop_front();
+            return true;
+        }
+
+    public:
+        system_scheduler(thread_pool& pool) :
+            pool(pool), systems(), graph_is_stale(true),
+            waiting_on(), unfinished(0), main_lock(), main_wake(), main_ready()
+        {}
+
+        //Adds a system with explicit access sets
+        void add(
+                component_signature reads,
+                component_signature writes,
+                bool runs_on_main_thread,
+                std::function<void()> update){
+            systems.push_back(scheduled_system{
+                    std::move(update), reads, writes, runs_on_main_thread, {}, 0});
+            graph_is_stale = true;
+        }
+
+        //Adds a system using the reads/writes/runs_on_main_thread it declares.
+        //The system has to outlive the scheduler.
+        template <class System>
+        void add(System& system){
+            add(system_reads<System>::template signature<ComponentPack>(),
+                    system_writes<System>::template signature<ComponentPack>(),
+                    system_pinned<System>::value,
+                    [&system]{system.update();});
+        }
+
+        void run_frame(){
+            if(systems.empty()) return;
+            if(graph_is_stale) build_graph();
+
+            unfinished = systems.size();
+            for(std::size_t i = 0; i < systems.size(); ++i){
+                waiting_on[i] = systems[i].dependency_count;
+            }
+            for(std::size_t i = 0; i < systems.size(); ++i){
+                if(systems[i].dependency_count == 0) schedule(i);
+            }
+
+            //The main thread runs pinned systems and otherwise helps the pool
+            while(unfinished > 0){
+                std::size_t index;
+                if(pop_main_ready(index)){
+                    run(index);
+                }
+                else if(!pool.run_one()){
+                    std::unique_lock<std::mutex> lock(main_lock);
+                    main_wake.wait_for(lock, std::chrono::microseconds(200),
+                            [this]{return unfinished == 0 || !main_ready.empty();});
+                }
+            }
+        }
+};
+
+#endif
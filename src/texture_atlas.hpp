@@ -0,0 +1,114 @@
+//Skyline bottom-left rectangle packer used to build texture atlases. The
+//packed area is described by its skyline, the top edge of everything
+//placed so far, as a list of horizontal segments. Every rect goes where
+//its top ends up lowest (ties go to the narrower gap), which wastes little
+//space for sprite sheets and is much cheaper than keeping every free rect.
+//skyline_packer packer(2048, 2048, 1);
+//SDL_Rect placement;
+//if(packer.pack(width, height, placement)){...}
+#ifndef TEXTURE_ATLAS_HPP
+#define TEXTURE_ATLAS_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+class skyline_packer{
+    private:
+        struct segment{
+            int x;
+            int y;
+            int width;
+        };
+
+        int width;
+        int height;
+        int padding;
+        int used_height;
+        std::vector<segment> skyline;
+
+        //Height at which a rect of rect_width would rest if its left edge
+        //were on segment index, -1 if it doesn't fit there
+        int fit(std::size_t index, int rect_width, int rect_height) const{
+            if(skyline[index].x + rect_width > width) return -1;
+            int top = 0;
+            int remaining = rect_width;
+            for(auto i = index; remaining > 0; ++i){
+                if(i == skyline.size()) return -1;
+                top = std::max(top, skyline[i].y);
+                if(top + rect_height > height) return -1;
+                remaining -= skyline[i].width;
+            }
+            return top;
+        }
+
+        void place(std::size_t index, int x, int y, int rect_width, int rect_height){
+            skyline.insert(std::begin(skyline) + index, segment{x, y + rect_height, rect_width});
+
+            //Trim or drop the segments now covered by the new one
+            for(auto i = index + 1; i < skyline.size(); ){
+                auto covered_until = skyline[index].x + skyline[index].width;
+                if(skyline[i].x >= covered_until) break;
+                auto overlap = covered_until - skyline[i].x;
+                if(overlap < skyline[i].width){
+                    skyline[i].x += overlap;
+                    skyline[i].width -= overlap;
+                    break;
+                }
+                skyline.erase(std::begin(skyline) + i);
+            }
+
+            //Neighbours at the same height become one segment
+            for(std::size_t i = 0; i + 1 < skyline.size(); ){
+                if(skyline[i].y == skyline[i + 1].y){
+                    skyline[i].width += skyline[i + 1].width;
+                    skyline.erase(std::begin(skyline) + i + 1);
+                }
+                else{
+                    ++i;
+                }
+            }
+        }
+
+    public:
+        skyline_packer(int width, int height, int padding = 0) :
+            width(width), height(height), padding(padding), used_height(0),
+            skyline{segment{0, 0, width}}
+        {}
+
+        int get_width() const{return width;}
+        int get_height() const{return height;}
+        //Lowest height that holds everything packed so far
+        int get_used_height() const{return used_height;}
+
+        //Finds room for a rect_width x rect_height rect (plus padding), false
+        //if it doesn't fit anymore
+        bool pack(int rect_width, int rect_height, SDL_Rect& placement){
+            int padded_width = rect_width + padding;
+            int padded_height = rect_height + padding;
+
+            auto best = skyline.size();
+            int best_top = std::numeric_limits<int>::max();
+            int best_width = std::numeric_limits<int>::max();
+            for(std::size_t i = 0; i < skyline.size(); ++i){
+                int top = fit(i, padded_width, padded_height);
+                if(top < 0) continue;
+                if(top < best_top || (top == best_top && skyline[i].width < best_width)){
+                    best = i;
+                    best_top = top;
+                    best_width = skyline[i].width;
+                }
+            }
+            if(best == skyline.size()) return false;
+
+            placement = SDL_Rect{skyline[best].x, best_top, rect_width, rect_height};
+            place(best, placement.x, best_top, padded_width, padded_height);
+            used_height = std::max(used_height, best_top + rect_height);
+            return true;
+        }
+};
+
+#endif
@@ -0,0 +1,181 @@
+//Work-stealing thread pool. Every worker owns a queue, tasks submitted
+//from a worker go to the back of its own queue and it keeps popping from
+//the back (most recently pushed, still warm in cache) while idle workers
+//steal from the front of everybody else's. Tasks submitted from outside
+//the pool are spread round-robin.
+
+//Threads that have to wait on tasks (see task_latch) should call
+//run_one() while waiting so they do useful work instead of blocking.
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class thread_pool{
+    public:
+        using task = std::function<void()>;
+
+    private:
+        struct worker_queue{
+            std::mutex lock;
+            std::deque<task> tasks;
+        };
+
+        //Lets submit() and run_one() know which queue the calling thread owns
+        struct worker_identity{
+            const thread_pool* pool = nullptr;
+            std::size_t index = 0;
+        };
+
+        static worker_identity& current_worker(){
+            static thread_local worker_identity identity;
+            return identity;
+        }
+
+        std::vector<std::unique_ptr<worker_queue>> queues;
+        std::vector<std::thread> workers;
+        std::atomic<bool> stopping;
+        std::atomic<std::size_t> pending;
+        std::atomic<std::size_t> next_queue;
+        std::mutex sleep_lock;
+        std::condition_variable wake;
+
+        bool pop_back(worker_queue& queue, task& out){
+            std::lock_guard<std::mutex> lock(queue.lock);
+            if(queue.tasks.empty()) return false;
+            out = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            return true;
+        }
+
+        bool steal_front(worker_queue& queue, task& out){
+            std::unique_lock<std::mutex> lock(queue.lock, std::try_to_lock);
+            if(!lock || queue.tasks.empty()) return false;
+            out = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            return true;
+        }
+
+        bool find_task(task& out){
+            auto& identity = current_worker();
+            auto home = (identity.pool == this) ? identity.index : next_queue.load() % queues.size();
+
+            if(pop_back(*queues[home], out)) return true;
+            for(std::size_t offset = 1; offset < queues.size(); ++offset){
+                if(steal_front(*queues[(home + offset) % queues.size()], out)) return true;
+            }
+            return false;
+        }
+
+        void work(std::size_t index){
+            current_worker() = worker_identity{this, index};
+            while(!stopping){
+                if(run_one()) continue;
+
+                //pending only goes up and stopping only changes under
+                //sleep_lock, so a wakeup can't slip in between the check
+                //and the wait
+                std::unique_lock<std::mutex> lock(sleep_lock);
+                wake.wait(lock, [this]{return stopping || pending > 0;});
+            }
+        }
+
+    public:
+        //Defaults to one worker per core minus the calling thread, which is
+        //expected to help out while it waits
+        explicit thread_pool(std::size_t thread_count = default_thread_count()) :
+            queues(), workers(), stopping(false), pending(0), next_queue(0), sleep_lock(), wake()
+        {
+            thread_count = std::max<std::size_t>(thread_count, 1);
+            for(std::size_t i = 0; i < thread_count; ++i){
+                queues.push_back(std::make_unique<worker_queue>());
+            }
+            for(std::size_t i = 0; i < thread_count; ++i){
+                workers.emplace_back([this, i]{work(i);});
+            }
+        }
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        ~thread_pool(){
+            {
+                std::lock_guard<std::mutex> lock(sleep_lock);
+                stopping = true;
+            }
+            wake.notify_all();
+            for(auto& worker : workers) worker.join();
+        }
+
+        static std::size_t default_thread_count(){
+            auto cores = std::thread::hardware_concurrency();
+            return (cores > 1) ? cores - 1 : 1;
+        }
+
+        std::size_t size() const{return workers.size();}
+
+        //1 + the calling thread's index in whichever pool it works for, 0
+        //for threads that aren't pool workers. Lets per-thread state live
+        //in small arrays instead of thread_local storage.
+        static std::size_t worker_slot(){
+            auto& identity = current_worker();
+            return identity.pool ? identity.index + 1 : 0;
+        }
+
+        void submit(task work){
+            auto& identity = current_worker();
+            auto index = (identity.pool == this) ? identity.index : next_queue++ % queues.size();
+            //Counted before it is queued so run_one can't take it first and
+            //wrap pending around
+            {
+                std::lock_guard<std::mutex> lock(sleep_lock);
+                ++pending;
+            }
+            {
+                std::lock_guard<std::mutex> lock(queues[index]->lock);
+                queues[index]->tasks.push_back(std::move(work));
+            }
+            wake.notify_one();
+        }
+
+        //Runs a single queued task on the calling thread if there is one
+        bool run_one(){
+            task work;
+            if(!find_task(work)) return false;
+            --pending;
+            work();
+            return true;
+        }
+};
+
+//Counts outstanding tasks so a thread can wait for a batch of them
+class task_latch{
+    private:
+        std::atomic<std::size_t> remaining;
+
+    public:
+        explicit task_latch(std::size_t count = 0) : remaining(count) {}
+
+        void add(std::size_t count = 1){remaining += count;}
+        void count_down(){--remaining;}
+        bool done() const{return remaining == 0;}
+
+        //Helps the pool with other work until every counted task is done
+        void wait(thread_pool& pool){
+            while(!done()){
+                if(!pool.run_one()) std::this_thread::yield();
+            }
+        }
+};
+
+#endif
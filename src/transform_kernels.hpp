@@ -0,0 +1,180 @@
+//Batch kernels over structure-of-arrays positions and sizes. Every kernel
+//works on plain float arrays (x[], y[], w[], h[]) so that several entities
+//are handled per instruction. The widest instruction set enabled at
+//compile time is used:
+//  __AVX2__    8 floats at a time (build with -mavx2)
+//  __SSE2__    4 floats at a time (always on for x86-64)
+//  otherwise   plain scalar loops
+//Arrays don't need any particular alignment, leftovers that don't fill a
+//full register go through the scalar path.
+#ifndef TRANSFORM_KERNELS_HPP
+#define TRANSFORM_KERNELS_HPP
+
+#include <cstddef>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <SDL2/SDL.h>
+
+static_assert(sizeof(SDL_Rect) == 4 * sizeof(int), "SDL_Rect is expected to be four packed ints");
+
+namespace transform_kernels{
+    namespace detail{
+#if defined(__AVX2__) || defined(__SSE2__)
+        //Transposes four x/y/w/h registers into four consecutive rects
+        inline void store_rects(__m128 x, __m128 y, __m128 w, __m128 h, void* destination){
+            _MM_TRANSPOSE4_PS(x, y, w, h);
+            auto out = reinterpret_cast<float*>(destination);
+            _mm_storeu_ps(out, x);
+            _mm_storeu_ps(out + 4, y);
+            _mm_storeu_ps(out + 8, w);
+            _mm_storeu_ps(out + 12, h);
+        }
+
+        //Same as store_rects but truncates every value to an int first
+        inline void store_int_rects(__m128 x, __m128 y, __m128 w, __m128 h, void* destination){
+            store_rects(
+                    _mm_castsi128_ps(_mm_cvttps_epi32(x)),
+                    _mm_castsi128_ps(_mm_cvttps_epi32(y)),
+                    _mm_castsi128_ps(_mm_cvttps_epi32(w)),
+                    _mm_castsi128_ps(_mm_cvttps_epi32(h)),
+                    destination);
+        }
+#endif
+
+        //Adds offset to every element of values
+        inline void add(float* values, std::size_t count, float offset){
+            std::size_t i = 0;
+#if defined(__AVX2__)
+            auto wide_offset = _mm256_set1_ps(offset);
+            for(; i + 8 <= count; i += 8){
+                _mm256_storeu_ps(values + i, _mm256_add_ps(_mm256_loadu_ps(values + i), wide_offset));
+            }
+#elif defined(__SSE2__)
+            auto wide_offset = _mm_set1_ps(offset);
+            for(; i + 4 <= count; i += 4){
+                _mm_storeu_ps(values + i, _mm_add_ps(_mm_loadu_ps(values + i), wide_offset));
+            }
+#endif
+            for(; i < count; ++i) values[i] += offset;
+        }
+
+        //values[i] += deltas[i] * factor
+        inline void add_scaled(float* values, const float* deltas, std::size_t count, float factor){
+            std::size_t i = 0;
+#if defined(__AVX2__)
+            auto wide_factor = _mm256_set1_ps(factor);
+            for(; i + 8 <= count; i += 8){
+                auto scaled = _mm256_mul_ps(_mm256_loadu_ps(deltas + i), wide_factor);
+                _mm256_storeu_ps(values + i, _mm256_add_ps(_mm256_loadu_ps(values + i), scaled));
+            }
+#elif defined(__SSE2__)
+            auto wide_factor = _mm_set1_ps(factor);
+            for(; i + 4 <= count; i += 4){
+                auto scaled = _mm_mul_ps(_mm_loadu_ps(deltas + i), wide_factor);
+                _mm_storeu_ps(values + i, _mm_add_ps(_mm_loadu_ps(values + i), scaled));
+            }
+#endif
+            for(; i < count; ++i) values[i] += deltas[i] * factor;
+        }
+
+        inline void multiply(float* values, std::size_t count, float factor){
+            std::size_t i = 0;
+#if defined(__AVX2__)
+            auto wide_factor = _mm256_set1_ps(factor);
+            for(; i + 8 <= count; i += 8){
+                _mm256_storeu_ps(values + i, _mm256_mul_ps(_mm256_loadu_ps(values + i), wide_factor));
+            }
+#elif defined(__SSE2__)
+            auto wide_factor = _mm_set1_ps(factor);
+            for(; i + 4 <= count; i += 4){
+                _mm_storeu_ps(values + i, _mm_mul_ps(_mm_loadu_ps(values + i), wide_factor));
+            }
+#endif
+            for(; i < count; ++i) values[i] *= factor;
+        }
+    }
+
+    //Moves every position by the same offset
+    inline void translate(float* x, float* y, std::size_t count, float dx, float dy){
+        detail::add(x, count, dx);
+        detail::add(y, count, dy);
+    }
+
+    //Moves every position by its own velocity over a time step
+    inline void translate(
+            float* x, float* y,
+            const float* dx, const float* dy,
+            std::size_t count, float step = 1.0f){
+        detail::add_scaled(x, dx, count, step);
+        detail::add_scaled(y, dy, count, step);
+    }
+
+    inline void scale(float* w, float* h, std::size_t count, float sx, float sy){
+        detail::multiply(w, count, sx);
+        detail::multiply(h, count, sy);
+    }
+
+    //Builds one rect per entity, fractions are truncated like a plain int cast
+    inline void to_rects(
+            const float* x, const float* y, const float* w, const float* h,
+            std::size_t count, SDL_Rect* rects){
+        std::size_t i = 0;
+#if defined(__AVX2__)
+        for(; i + 8 <= count; i += 8){
+            auto wide_x = _mm256_loadu_ps(x + i);
+            auto wide_y = _mm256_loadu_ps(y + i);
+            auto wide_w = _mm256_loadu_ps(w + i);
+            auto wide_h = _mm256_loadu_ps(h + i);
+            detail::store_int_rects(
+                    _mm256_castps256_ps128(wide_x), _mm256_castps256_ps128(wide_y),
+                    _mm256_castps256_ps128(wide_w), _mm256_castps256_ps128(wide_h),
+                    rects + i);
+            detail::store_int_rects(
+                    _mm256_extractf128_ps(wide_x, 1), _mm256_extractf128_ps(wide_y, 1),
+                    _mm256_extractf128_ps(wide_w, 1), _mm256_extractf128_ps(wide_h, 1),
+                    rects + i + 4);
+        }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+        for(; i + 4 <= count; i += 4){
+            detail::store_int_rects(
+                    _mm_loadu_ps(x + i), _mm_loadu_ps(y + i),
+                    _mm_loadu_ps(w + i), _mm_loadu_ps(h + i),
+                    rects + i);
+        }
+#endif
+        for(; i < count; ++i){
+            rects[i] = SDL_Rect{
+                static_cast<int>(x[i]), static_cast<int>(y[i]),
+                static_cast<int>(w[i]), static_cast<int>(h[i])};
+        }
+    }
+
+#if SDL_VERSION_ATLEAST(2, 0, 10)
+    static_assert(sizeof(SDL_FRect) == 4 * sizeof(float), "SDL_FRect is expected to be four packed floats");
+
+    inline void to_frects(
+            const float* x, const float* y, const float* w, const float* h,
+            std::size_t count, SDL_FRect* rects){
+        std::size_t i = 0;
+#if defined(__AVX2__) || defined(__SSE2__)
+        for(; i + 4 <= count; i += 4){
+            detail::store_rects(
+                    _mm_loadu_ps(x + i), _mm_loadu_ps(y + i),
+                    _mm_loadu_ps(w + i), _mm_loadu_ps(h + i),
+                    rects + i);
+        }
+#endif
+        for(; i < count; ++i){
+            rects[i] = SDL_FRect{x[i], y[i], w[i], h[i]};
+        }
+    }
+#endif
+}
+
+#endif
@@ -0,0 +1,150 @@
+//Structure-of-arrays storage for the data held by position_component and
+//size_component. Where the component pools keep a handle and two floats
+//per entry, this keeps every field in its own contiguous float array so
+//that the batch kernels in transform_kernels.hpp can process many entities
+//per instruction. Slots are packed like a sparse_set: removing an entity
+//moves the last one into its slot.
+#ifndef TRANSFORM_SOA_HPP
+#define TRANSFORM_SOA_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+#include "game_components.hpp"
+#include "sparse_set.hpp"
+#include "transform_kernels.hpp"
+
+//Bare x[], y[], w[], h[] arrays, also usable as per-frame scratch space
+struct rect_arrays{
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> w;
+    std::vector<float> h;
+
+    std::size_t size() const{return x.size();}
+
+    void push_back(float left, float top, float width, float height){
+        x.push_back(left);
+        y.push_back(top);
+        w.push_back(width);
+        h.push_back(height);
+    }
+
+    void reserve(std::size_t count){
+        x.reserve(count);
+        y.reserve(count);
+        w.reserve(count);
+        h.reserve(count);
+    }
+
+    void clear(){
+        x.clear();
+        y.clear();
+        w.clear();
+        h.clear();
+    }
+
+    void move_slot(std::size_t target, std::size_t source){
+        x[target] = x[source];
+        y[target] = y[source];
+        w[target] = w[source];
+        h[target] = h[source];
+    }
+
+    void pop_back(){
+        x.pop_back();
+        y.pop_back();
+        w.pop_back();
+        h.pop_back();
+    }
+
+    void translate(float dx, float dy){transform_kernels::translate(x.data(), y.data(), size(), dx, dy);}
+    void scale(float sx, float sy){transform_kernels::scale(w.data(), h.data(), size(), sx, sy);}
+
+    //Maps world rects to screen rects: moves origin_x/origin_y to
+    //screen_x/screen_y and scales everything by zoom around it
+    void to_screen(float origin_x, float origin_y, float zoom, float screen_x, float screen_y){
+        translate(-origin_x, -origin_y);
+        transform_kernels::scale(x.data(), y.data(), size(), zoom, zoom);
+        scale(zoom, zoom);
+        translate(screen_x, screen_y);
+    }
+
+    //Resizes rects to match and fills it with one rect per slot
+    void to_rects(std::vector<SDL_Rect>& rects) const{
+        rects.resize(size());
+        transform_kernels::to_rects(x.data(), y.data(), w.data(), h.data(), size(), rects.data());
+    }
+
+#if SDL_VERSION_ATLEAST(2, 0, 10)
+    void to_frects(std::vector<SDL_FRect>& rects) const{
+        rects.resize(size());
+        transform_kernels::to_frects(x.data(), y.data(), w.data(), h.data(), size(), rects.data());
+    }
+#endif
+};
+
+class transform_soa{
+    private:
+        std::vector<component_id> ids;
+        rect_arrays bounds;
+        sparse_index<component_id> slots;
+
+        static constexpr std::size_t npos = sparse_index<component_id>::npos;
+
+    public:
+        std::size_t size() const{return ids.size();}
+        bool empty() const{return ids.empty();}
+        bool contains(const component_id& id) const{return slots.find(id) != npos;}
+
+        //Slot of id in the arrays, or npos when it isn't stored
+        std::size_t slot_of(const component_id& id) const{return slots.find(id);}
+        const component_id* entity_ids() const{return ids.data();}
+        rect_arrays& arrays(){return bounds;}
+        const rect_arrays& arrays() const{return bounds;}
+
+        void reserve(std::size_t count){
+            ids.reserve(count);
+            bounds.reserve(count);
+            slots.reserve(count);
+        }
+
+        //Returns false without changing anything when id is already stored
+        bool emplace(const component_id& id, float x, float y, float w, float h){
+            if(contains(id)) return false;
+            slots.set(id, ids.size());
+            ids.push_back(id);
+            bounds.push_back(x, y, w, h);
+            return true;
+        }
+
+        bool erase(const component_id& id){
+            auto slot = slots.find(id);
+            if(slot == npos) return false;
+
+            auto last = ids.size() - 1;
+            if(slot != last){
+                ids[slot] = ids[last];
+                bounds.move_slot(slot, last);
+                slots.set(ids[slot], slot);
+            }
+            ids.pop_back();
+            bounds.pop_back();
+            slots.erase(id);
+            return true;
+        }
+
+        void clear(){
+            ids.clear();
+            bounds.clear();
+            slots.clear();
+        }
+
+        void translate(float dx, float dy){bounds.translate(dx, dy);}
+        void scale(float sx, float sy){bounds.scale(sx, sy);}
+        void to_rects(std::vector<SDL_Rect>& rects) const{bounds.to_rects(rects);}
+};
+
+#endif